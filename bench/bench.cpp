@@ -0,0 +1,175 @@
+#include "bench.hpp"
+
+#include <asio/write.hpp>
+#include <asio/buffer.hpp>
+#include <asio/read_until.hpp>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+
+namespace
+{
+    bool isJsonOutput = false;
+}
+
+void setJsonOutput(bool isJsonOutputParam)
+{
+    isJsonOutput = isJsonOutputParam;
+}
+
+std::string buildNotifications(std::size_t messageCount, WireEncoding wireEncoding)
+{
+    std::string data;
+    for (std::size_t i = 0; i < messageCount; i++)
+    {
+        std::size_t methodIndex = i%INDEXED_VALUE_METHOD_COUNT;
+        bool isBool = methodIndex == 1 || methodIndex == 4;
+        if (wireEncoding == WireEncoding::BINARY)
+        {
+            appendWireIndexedValueFrame(data, static_cast<IndexedValueMethod>(methodIndex),
+                    static_cast<std::uint16_t>(i%4), static_cast<std::int32_t>(i), isBool ? i%2 : i%256);
+            continue;
+        }
+        data += std::string("{\"jsonrpc\":\"2.0\",\"method\":\"") + std::string(INDEXED_VALUE_METHOD_NAMES[methodIndex])
+                + "\",\"params\":{\"index\":" + std::to_string(i%4) + ",\"value\":"
+                + (isBool ? (i%2 ? "true" : "false") : std::to_string(i%256))
+                + ",\"changedCount\":" + std::to_string(i) + "}}\n";
+    }
+    return data;
+}
+
+LoopbackServer::LoopbackServer()
+    : _ioc()
+    , _acceptor(_ioc, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+    , _socket(_ioc)
+    , _receiveStreambuf()
+{}
+
+LoopbackServer::~LoopbackServer()
+{
+    asio::error_code ec;
+    _socket.close(ec);
+}
+
+void LoopbackServer::accept()
+{
+    _acceptor.accept(_socket);
+}
+
+void LoopbackServer::disconnect()
+{
+    _socket.close();
+    _receiveStreambuf.consume(_receiveStreambuf.size());
+}
+
+void LoopbackServer::write(const std::string & data)
+{
+    asio::write(_socket, asio::buffer(data));
+}
+
+std::string LoopbackServer::readLine()
+{
+    std::size_t lineSize = asio::read_until(_socket, _receiveStreambuf, static_cast<char>(0x0A));
+    std::string line(static_cast<const char *>(_receiveStreambuf.data().data()), lineSize - 1);
+    _receiveStreambuf.consume(lineSize);
+    return line;
+}
+
+std::size_t LoopbackServer::drainLines(std::size_t lineCount)
+{
+    std::size_t byteCount = 0;
+    std::size_t readLineCount = 0;
+    std::array<char, 65536> buffer;
+    while (readLineCount < lineCount)
+    {
+        std::size_t readSize = _socket.read_some(asio::buffer(buffer));
+        byteCount += readSize;
+        readLineCount += std::count(buffer.begin(), buffer.begin() + readSize, static_cast<char>(0x0A));
+    }
+    return byteCount;
+}
+
+void LoopbackServer::answerMethodCalls(std::size_t requestCount)
+{
+    static const std::string_view ID_MEMBER = "\"id\"";
+    static const std::string_view RESPONSE_BEGIN = "{\"jsonrpc\":\"2.0\",\"result\":null,\"id\":";
+    std::array<char, 4096> response;
+    for (std::size_t i = 0; i < requestCount; i++)
+    {
+        std::size_t lineSize = asio::read_until(_socket, _receiveStreambuf, static_cast<char>(0x0A));
+        std::string_view line(static_cast<const char *>(_receiveStreambuf.data().data()), lineSize);
+
+        // Answer each call of a batch in one array
+        bool isBatch = line.front() == '[';
+        char * end = response.data();
+        if (isBatch)
+            *end++ = '[';
+        for (std::size_t idMember = line.find(ID_MEMBER); idMember != std::string_view::npos;
+                idMember = line.find(ID_MEMBER, idMember + ID_MEMBER.size()))
+        {
+            std::size_t idBegin = line.find_first_of("0123456789", idMember + ID_MEMBER.size());
+            std::size_t idEnd = line.find_first_not_of("0123456789", idBegin);
+            if (end != response.data() + (isBatch ? 1 : 0))
+                *end++ = ',';
+            end = std::copy(RESPONSE_BEGIN.begin(), RESPONSE_BEGIN.end(), end);
+            end = std::copy(line.begin() + idBegin, line.begin() + idEnd, end);
+            *end++ = '}';
+        }
+        if (isBatch)
+            *end++ = ']';
+        *end++ = static_cast<char>(0x0A);
+        _receiveStreambuf.consume(lineSize);
+        asio::write(_socket, asio::buffer(response.data(), end - response.data()));
+    }
+}
+
+void printResult(const std::string & name, std::size_t operationCount,
+        std::chrono::nanoseconds duration, std::size_t allocations, std::optional<std::size_t> bytes)
+{
+    if (isJsonOutput)
+    {
+        std::cout << "{\"name\":\"" << name << "\",\"ops\":" << operationCount
+                  << std::fixed << std::setprecision(1)
+                  << ",\"ns_per_op\":" << static_cast<double>(duration.count())/operationCount
+                  << std::setprecision(2)
+                  << ",\"allocs_per_op\":" << static_cast<double>(allocations)/operationCount;
+        if (bytes.has_value())
+            std::cout << std::setprecision(1) << ",\"bytes_per_op\":" << static_cast<double>(bytes.value())/operationCount;
+        std::cout << "}" << std::endl;
+        return;
+    }
+    std::cout << std::left << std::setw(32) << name << std::right
+              << " ops=" << std::setw(9) << operationCount
+              << " ns/op=" << std::setw(9) << std::fixed << std::setprecision(1)
+              << static_cast<double>(duration.count())/operationCount
+              << " allocs/op=" << std::setw(6) << std::setprecision(2)
+              << static_cast<double>(allocations)/operationCount;
+    if (bytes.has_value())
+        std::cout << " bytes/op=" << std::setw(6) << std::setprecision(1)
+                  << static_cast<double>(bytes.value())/operationCount;
+    std::cout << std::endl;
+}
+
+void printPercentiles(const std::string & name, std::vector<std::chrono::nanoseconds> latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double ratio){
+        return latencies.at(static_cast<std::size_t>(ratio*(latencies.size()-1))).count();
+    };
+    if (isJsonOutput)
+    {
+        std::cout << "{\"name\":\"" << name << "\",\"ops\":" << latencies.size()
+                  << ",\"p50_ns\":" << percentile(0.5) << ",\"p90_ns\":" << percentile(0.9)
+                  << ",\"p99_ns\":" << percentile(0.99) << ",\"max_ns\":" << latencies.back().count() << "}" << std::endl;
+        return;
+    }
+    std::cout << std::left << std::setw(32) << name << std::right
+              << " ops=" << std::setw(9) << latencies.size()
+              << " p50_ns=" << std::setw(9) << percentile(0.5)
+              << " p90_ns=" << std::setw(9) << percentile(0.9)
+              << " p99_ns=" << std::setw(9) << percentile(0.99)
+              << " max_ns=" << std::setw(9) << latencies.back().count() << std::endl;
+}
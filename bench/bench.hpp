@@ -0,0 +1,102 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "indexedvaluenotification.hpp"
+#include "wireprotocol.hpp"
+
+#include <asio/ip/tcp.hpp>
+#include <asio/streambuf.hpp>
+#include <asio/io_context.hpp>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+//! @return The number of heap allocations done by the whole process since its start.
+std::size_t allocationCount();
+
+//! @brief Print the results as one JSON object per line instead of aligned text.
+void setJsonOutput(bool isJsonOutput);
+
+//! @brief Print one bench result on one line.
+//! @param bytes Bytes received or sent by all the operations, if meaningful.
+void printResult(const std::string & name, std::size_t operationCount,
+        std::chrono::nanoseconds duration, std::size_t allocations, std::optional<std::size_t> bytes = std::nullopt);
+
+//! @brief Print the percentiles of a latency distribution on one line.
+void printPercentiles(const std::string & name, std::vector<std::chrono::nanoseconds> latencies);
+
+//! @return messageCount sensor notifications cycling over the sensor methods, one per line in JSON or
+//! one per frame in binary.
+std::string buildNotifications(std::size_t messageCount, WireEncoding wireEncoding = WireEncoding::JSON);
+
+//! @brief Count the received notifications until an expected count.
+class NotificationCounter : public IndexedValueNotificationReceiver
+{
+public:
+    NotificationCounter(std::size_t expectedCount) : _expectedCount(expectedCount), _receivedCount(0), _done(0) {}
+
+    void receiveIndexedValueNotification(const IndexedValueNotification &) override {count();}
+    void count() {if (++_receivedCount == _expectedCount) _done.release();}
+
+    //! @brief Wait until the expected count has been received.
+    void wait() {_done.acquire();}
+    std::size_t receivedCount() const {return _receivedCount;}
+
+private:
+    std::size_t _expectedCount;
+    std::atomic<std::size_t> _receivedCount;
+    std::binary_semaphore _done;
+};
+
+//! @brief Minimal TCP server accepting one client, used to feed a JsonRpcTcpClient on loopback.
+class LoopbackServer
+{
+public:
+    LoopbackServer();
+    ~LoopbackServer();
+
+    unsigned short port() const {return _acceptor.local_endpoint().port();}
+
+    //! @brief Wait for the client connection.
+    void accept();
+
+    //! @brief Close the client connection, to accept its next one.
+    void disconnect();
+
+    //! @brief Send raw bytes to the client.
+    void write(const std::string & data);
+
+    //! @brief Wait for one newline-delimited message of the client.
+    //! @return The message without its end of line.
+    std::string readLine();
+
+    //! @brief Read and drop lineCount newline-delimited messages of the client, without allocation.
+    //! @return The number of bytes read.
+    std::size_t drainLines(std::size_t lineCount);
+
+    //! @brief Answer a null result to the next requestCount method calls or batches of the client,
+    //! without allocation once the receive buffer has grown.
+    void answerMethodCalls(std::size_t requestCount);
+
+private:
+    LoopbackServer(const LoopbackServer &) = delete;
+    LoopbackServer & operator=(const LoopbackServer &) = delete;
+
+    asio::io_context _ioc;
+    asio::ip::tcp::acceptor _acceptor;
+    asio::ip::tcp::socket _socket;
+    asio::streambuf _receiveStreambuf;
+};
+
+void receiveBench();
+void sendBench();
+void valuesBench();
+void waitBench();
+void fleetBench();
+
+#endif
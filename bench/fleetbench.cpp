@@ -0,0 +1,68 @@
+#include "bench.hpp"
+#include "jsonrpctcpclient.hpp"
+
+#include <asio/executor_work_guard.hpp>
+#include <algorithm>
+#include <memory>
+
+
+namespace
+{
+    const std::size_t CONNECTION_COUNT = 64;
+    const std::size_t MESSAGE_COUNT_PER_CONNECTION = 20000;
+
+    //! @brief Feed CONNECTION_COUNT clients at the same time, each from its own loopback server.
+    //! @param threadCount Number of threads running a shared context, or 0 for a receive thread per client.
+    void fleetReceiveBench(const std::string & data, std::size_t threadCount)
+    {
+        asio::io_context ioContext;
+        auto workGuard = asio::make_work_guard(ioContext);
+        std::vector<std::unique_ptr<LoopbackServer>> servers;
+        std::vector<std::unique_ptr<JsonRpcTcpClient>> clients;
+        NotificationCounter notificationCounter(CONNECTION_COUNT*MESSAGE_COUNT_PER_CONNECTION);
+        for (std::size_t i = 0; i < CONNECTION_COUNT; i++)
+        {
+            servers.push_back(std::make_unique<LoopbackServer>());
+            if (threadCount == 0)
+                clients.push_back(std::make_unique<JsonRpcTcpClient>("127.0.0.1", servers.back()->port()));
+            else
+                clients.push_back(std::make_unique<JsonRpcTcpClient>(ioContext, "127.0.0.1", servers.back()->port()));
+            servers.back()->accept();
+            clients.back()->bindIndexedValueNotifications(notificationCounter);
+            clients.back()->startReceive();
+        }
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < threadCount; i++)
+            threads.emplace_back([&ioContext]{ioContext.run();});
+
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> writers;
+        for (auto & server : servers)
+            writers.emplace_back([&server, &data]{server->write(data);});
+        notificationCounter.wait();
+        auto duration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+        for (auto & writer : writers)
+            writer.join();
+        printResult("fleet/" + std::to_string(CONNECTION_COUNT) + "clients/"
+                + (threadCount == 0 ? std::string("threadPerClient") : std::to_string(threadCount) + "threads"),
+                notificationCounter.receivedCount(), duration, allocations);
+
+        // The clients wait for their pending reads, so the context must still run
+        clients.clear();
+        workGuard.reset();
+        for (auto & thread : threads)
+            thread.join();
+    }
+}
+
+void fleetBench()
+{
+    std::string data = buildNotifications(MESSAGE_COUNT_PER_CONNECTION);
+    fleetReceiveBench(data, 0);
+    std::size_t hardwareThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t threadCount = 1; threadCount < hardwareThreadCount; threadCount *= 2)
+        fleetReceiveBench(data, threadCount);
+    fleetReceiveBench(data, hardwareThreadCount);
+}
@@ -0,0 +1,57 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+
+namespace
+{
+    std::atomic<std::size_t> allocations(0);
+}
+
+void * operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+std::size_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--json") == 0)
+            setJsonOutput(true);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--json]" << std::endl;
+            return 1;
+        }
+    }
+
+    receiveBench();
+    sendBench();
+    valuesBench();
+    waitBench();
+    fleetBench();
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "bench.hpp"
+#include "jsonrpctcpclient.hpp"
+
+#include <asio/executor_work_guard.hpp>
+#include <json/json.h>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+
+namespace
+{
+    const std::size_t MESSAGE_COUNT = 200000;
+
+    //! @brief Copy of the receive loop before the receive engine rework, as a reference.
+    void legacyReceiveBench(const std::string & data)
+    {
+        std::size_t received = 0;
+        std::map<std::string, std::function<void(Json::Value)>> notificationHandles;
+        for (auto methodName : INDEXED_VALUE_METHOD_NAMES)
+            notificationHandles.insert(std::make_pair(std::string(methodName), [&received](const Json::Value &){received++;}));
+        std::istringstream tcpInStream(data);
+
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < MESSAGE_COUNT; i++)
+        {
+            std::string messageJsonStr;
+            std::getline(tcpInStream, messageJsonStr, static_cast<char>(0x0A));
+            Json::CharReaderBuilder builder;
+            JSONCPP_STRING errs;
+            Json::Value messageJson;
+            const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+            if (!reader->parse(messageJsonStr.c_str(), messageJsonStr.c_str()+messageJsonStr.size(),
+                    &messageJson, &errs))
+                throw std::runtime_error(errs);
+            auto it = notificationHandles.find(messageJson["method"].asString());
+            if (it != notificationHandles.end())
+                it->second(messageJson["params"]);
+        }
+        auto duration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+        printResult("receive/legacy", received, duration, allocations);
+    }
+
+    //! @brief Feed a real JsonRpcTcpClient through a loopback socket.
+    //! @param isIndexedValue Bind the sensor notifications receiver or the generic Json::Value handles.
+    //! @param wireEncoding Encoding of data, negotiated with the client before the measure.
+    void clientReceiveBench(const std::string & data, bool isIndexedValue, WireEncoding wireEncoding)
+    {
+        LoopbackServer server;
+        JsonRpcTcpClient client("127.0.0.1", server.port());
+        server.accept();
+
+        NotificationCounter notificationCounter(MESSAGE_COUNT);
+        if (isIndexedValue)
+            client.bindIndexedValueNotifications(notificationCounter);
+        else
+            for (auto methodName : INDEXED_VALUE_METHOD_NAMES)
+                client.bindNotification(std::string(methodName), [&notificationCounter](const Json::Value &){notificationCounter.count();});
+        client.startReceive();
+        if (wireEncoding == WireEncoding::BINARY)
+        {
+            std::thread negotiation([&client]{client.negotiateWireEncoding(WireEncoding::BINARY);});
+            Json::Value request;
+            std::istringstream(server.readLine()) >> request;
+            server.write("{\"jsonrpc\":\"2.0\",\"id\":" + request["id"].asString() + ",\"result\":\"binary\"}\n");
+            negotiation.join();
+        }
+
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        server.write(data);
+        notificationCounter.wait();
+        auto duration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+        std::string name = wireEncoding == WireEncoding::BINARY ? "receive/binary"
+                : isIndexedValue ? "receive/indexedValue" : "receive/generic";
+        printResult(name, notificationCounter.receivedCount(), duration, allocations, data.size());
+    }
+
+    //! @brief Measure the time from a connexion loss to the first notification received on the next
+    //! connexion, the loopback server accepting it at once.
+    //! @param isAsyncReceive Receive with asynchronous reads on a shared context instead of a thread.
+    void resumeBench(bool isAsyncReceive)
+    {
+        const std::size_t RESUME_COUNT = 500;
+        class ResumeReceiver : public IndexedValueNotificationReceiver
+        {
+        public:
+            ResumeReceiver() : _received(0) {}
+            void receiveIndexedValueNotification(const IndexedValueNotification &) override {_received.release();}
+            void wait() {_received.acquire();}
+        private:
+            std::binary_semaphore _received;
+        };
+
+        asio::io_context ioContext;
+        auto workGuard = asio::make_work_guard(ioContext);
+        std::thread ioThread([&ioContext]{ioContext.run();});
+        {
+            LoopbackServer server;
+            std::unique_ptr<JsonRpcTcpClient> client = isAsyncReceive
+                    ? std::make_unique<JsonRpcTcpClient>(ioContext, "127.0.0.1", server.port())
+                    : std::make_unique<JsonRpcTcpClient>("127.0.0.1", server.port());
+            server.accept();
+            ResumeReceiver resumeReceiver;
+            client->bindIndexedValueNotifications(resumeReceiver);
+            client->startReceive();
+
+            std::string notification = buildNotifications(1);
+            std::vector<std::chrono::nanoseconds> latencies;
+            latencies.reserve(RESUME_COUNT);
+            for (std::size_t i = 0; i < RESUME_COUNT; i++)
+            {
+                auto begin = std::chrono::steady_clock::now();
+                server.disconnect();
+                server.accept();
+                server.write(notification);
+                resumeReceiver.wait();
+                latencies.push_back(std::chrono::steady_clock::now() - begin);
+            }
+            printPercentiles(isAsyncReceive ? "resume/asyncReceive" : "resume/threadReceive", latencies);
+        }
+        workGuard.reset();
+        ioThread.join();
+    }
+}
+
+void receiveBench()
+{
+    std::string data = buildNotifications(MESSAGE_COUNT);
+    legacyReceiveBench(data);
+    clientReceiveBench(data, false, WireEncoding::JSON);
+    clientReceiveBench(data, true, WireEncoding::JSON);
+    clientReceiveBench(buildNotifications(MESSAGE_COUNT, WireEncoding::BINARY), true, WireEncoding::BINARY);
+    resumeBench(false);
+    resumeBench(true);
+}
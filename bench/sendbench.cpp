@@ -0,0 +1,142 @@
+#include "bench.hpp"
+#include "jsonrpctcpclient.hpp"
+
+#include <json/value.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+    const std::size_t NOTIFICATION_COUNT = 200000;
+    const std::size_t CALL_COUNT = 20000;
+
+    //! @brief Wait for the connexion of client, the notifications sent before are dropped.
+    void waitConnected(const JsonRpcTcpClient & client)
+    {
+        while (!client.isConnected())
+            std::this_thread::yield();
+    }
+
+    //! @brief Send motors commands from senderCount threads, the loopback server reads them from another thread.
+    //! @param isFixedShape True to format them as Robot does, without Json::Value.
+    void callNotificationBench(bool isFixedShape, std::size_t senderCount)
+    {
+        LoopbackServer server;
+        JsonRpcTcpClient client("127.0.0.1", server.port());
+        server.accept();
+        client.startReceive();
+        waitConnected(client);
+        std::size_t byteCount = 0;
+        std::thread reader([&server, &byteCount]{byteCount = server.drainLines(NOTIFICATION_COUNT);});
+
+        auto send = [&client, isFixedShape](std::size_t begin, std::size_t end){
+            for (std::size_t i = begin; i < end; i++)
+            {
+                float rightValue = static_cast<float>(i%200)/100.0f - 1.0f;
+                float leftValue = 1.0f - static_cast<float>(i%200)/100.0f;
+                if (isFixedShape)
+                    client.callNotification("setMotorsPower", {{"rightValue", rightValue}, {"leftValue", leftValue}});
+                else
+                {
+                    Json::Value params;
+                    params["rightValue"] = rightValue;
+                    params["leftValue"] = leftValue;
+                    client.callNotification("setMotorsPower", params);
+                }
+            }
+        };
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        if (senderCount == 1)
+            send(0, NOTIFICATION_COUNT);
+        else
+        {
+            std::vector<std::thread> senders;
+            for (std::size_t i = 0; i < senderCount; i++)
+                senders.emplace_back(send, NOTIFICATION_COUNT*i/senderCount, NOTIFICATION_COUNT*(i + 1)/senderCount);
+            for (std::thread & sender : senders)
+                sender.join();
+        }
+        auto duration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+        reader.join();
+        std::string name = isFixedShape ? "send/callNotification/fixedShape" : "send/callNotification";
+        if (senderCount > 1)
+            name.append("/").append(std::to_string(senderCount)).append("senders");
+        printResult(name, NOTIFICATION_COUNT, duration, allocations, byteCount);
+    }
+
+    //! @brief Measure the round trip of blocking method calls answered by the loopback server.
+    void callMethodBench()
+    {
+        LoopbackServer server;
+        JsonRpcTcpClient client("127.0.0.1", server.port());
+        server.accept();
+        client.startReceive();
+        std::thread answerer([&server]{server.answerMethodCalls(CALL_COUNT);});
+
+        std::vector<std::chrono::nanoseconds> latencies;
+        latencies.reserve(CALL_COUNT);
+        Json::Value params;
+        params["index"] = 0;
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < CALL_COUNT; i++)
+        {
+            auto callBegin = std::chrono::steady_clock::now();
+            client.callMethod("getEncoderWheelValue", params);
+            latencies.push_back(std::chrono::steady_clock::now() - callBegin);
+        }
+        auto duration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+        answerer.join();
+        printResult("call/callMethod", CALL_COUNT, duration, allocations);
+        printPercentiles("call/callMethod/roundTrip", latencies);
+    }
+
+    //! @brief Read the six sensor families, with one method call each or with one batch of six calls.
+    void fetchBench(bool isBatch)
+    {
+        const std::size_t FETCH_COUNT = 5000;
+        LoopbackServer server;
+        JsonRpcTcpClient client("127.0.0.1", server.port());
+        server.accept();
+        client.startReceive();
+        std::thread answerer([&server, isBatch]{server.answerMethodCalls(isBatch ? FETCH_COUNT : FETCH_COUNT*INDEXED_VALUE_METHOD_COUNT);});
+
+        std::vector<JsonRpcTcpClient::BatchCall> calls;
+        for (std::string_view methodName : INDEXED_VALUE_METHOD_NAMES)
+        {
+            Json::Value params;
+            params["method"] = std::string(methodName);
+            calls.push_back({"getSensorValues", params});
+        }
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < FETCH_COUNT; i++)
+        {
+            if (isBatch)
+                client.callBatch(calls);
+            else
+                for (const auto & call : calls)
+                    client.callMethod(call.methodName.c_str(), call.params);
+        }
+        auto duration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+        answerer.join();
+        printResult(isBatch ? "fetch/batch" : "fetch/sequential", FETCH_COUNT, duration, allocations);
+    }
+}
+
+void sendBench()
+{
+    callNotificationBench(false, 1);
+    callNotificationBench(true, 1);
+    callNotificationBench(true, 4);
+    callMethodBench();
+    fetchBench(false);
+    fetchBench(true);
+}
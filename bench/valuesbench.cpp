@@ -0,0 +1,115 @@
+#include "bench.hpp"
+#include "values.hpp"
+#include "linetracker.hpp"
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+    enum class ValuesBenchEventType {VALUE};
+    const std::size_t SET_COUNT = 1000000;
+    const std::size_t INDEX_COUNT = 8;
+
+    using BenchValues = Values<std::size_t, ValuesBenchEventType, ValuesBenchEventType::VALUE>;
+
+    class NullRobot : public IRobot<ValuesBenchEventType>
+    {
+    public:
+        void notify(ValuesBenchEventType, int) override {}
+    };
+
+    //! @brief Set values from one thread, as the receive thread does, while readerCount threads read
+    //! them as fast as possible with get or with a consistent snapshot. The readers only read between
+    //! the begin and the end of the timed window, and the allocations of the window, counted for the whole
+    //! process, are given to both the writer and the reader results.
+    void valuesContentionBench(std::size_t readerCount, bool isSnapshot)
+    {
+        NullRobot robot;
+        SeqLock seqLock;
+        BenchValues values(&robot, seqLock);
+        std::atomic<std::size_t> readyReaderCount(0);
+        std::atomic<bool> isStarted(false);
+        std::atomic<bool> isWriting(true);
+        std::atomic<std::size_t> readCount(0);
+        std::atomic<std::size_t> readChecksum(0);
+
+        std::vector<std::thread> readers;
+        for (std::size_t i = 0; i < readerCount; i++)
+        {
+            readers.emplace_back([&values, &readyReaderCount, &isStarted, &isWriting, &readCount, &readChecksum, isSnapshot]{
+                readyReaderCount++;
+                while (!isStarted.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                std::size_t count = 0;
+                std::size_t checksum = 0;
+                while (isWriting.load(std::memory_order_relaxed))
+                {
+                    if (isSnapshot)
+                        checksum += values.snapshot().get(count%INDEX_COUNT);
+                    else
+                        checksum += values.get(count%INDEX_COUNT);
+                    count++;
+                }
+                readCount += count;
+                readChecksum += checksum;
+            });
+        }
+        while (readyReaderCount.load() < readerCount)
+            std::this_thread::yield();
+
+        std::array<int, INDEX_COUNT> changedCounts;
+        changedCounts.fill(0);
+        auto receiveTime = std::chrono::steady_clock::now();
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        isStarted.store(true, std::memory_order_release);
+        for (std::size_t i = 0; i < SET_COUNT; i++)
+        {
+            std::size_t index = i%INDEX_COUNT;
+            values.set(index, i, ++changedCounts[index], receiveTime);
+        }
+        auto duration = std::chrono::steady_clock::now() - begin;
+        isWriting = false;
+        for (auto & reader : readers)
+            reader.join();
+        auto readDuration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+
+        std::string readerName = std::to_string(readerCount) + "readers";
+        printResult(std::string(isSnapshot ? "values/setWithSnapshot/" : "values/set/") + readerName, SET_COUNT, duration, allocations);
+        if (readCount > 0)
+            printResult(std::string(isSnapshot ? "values/snapshot/" : "values/get/") + readerName, readCount,
+                    readDuration*readerCount, allocations);
+    }
+
+    //! @brief Update the line position at each raw value of a bar of sensorCount line track sensors.
+    void lineTrackerBench(std::size_t sensorCount)
+    {
+        LineTracker::Config config;
+        config.sensorCount = sensorCount;
+        LineTracker lineTracker(config);
+        auto receiveTime = std::chrono::steady_clock::now();
+        std::size_t allocationsBegin = allocationCount();
+        auto begin = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < SET_COUNT; i++)
+            lineTracker.update(i%sensorCount, static_cast<std::uint8_t>(i*7), receiveTime);
+        auto duration = std::chrono::steady_clock::now() - begin;
+        std::size_t allocations = allocationCount() - allocationsBegin;
+        printResult("values/lineTracker/" + std::to_string(sensorCount) + "sensors", SET_COUNT, duration, allocations);
+    }
+}
+
+void valuesBench()
+{
+    for (std::size_t readerCount : {0, 1, 3})
+    {
+        valuesContentionBench(readerCount, false);
+        valuesContentionBench(readerCount, true);
+    }
+    lineTrackerBench(8);
+    lineTrackerBench(16);
+}
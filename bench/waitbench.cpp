@@ -0,0 +1,145 @@
+#include "bench.hpp"
+#include "eventdispatcher.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+
+namespace
+{
+    enum class BenchEventType {TARGET, OTHER_1, OTHER_2, OTHER_3, OTHER_4, OTHER_5};
+    const std::size_t BENCH_EVENT_TYPE_COUNT = 6;
+    const std::size_t WAKEUP_COUNT = 2000;
+
+    //! @brief Copy of the single condition variable wait of Robot before the event dispatcher, as a reference.
+    class LegacyEventWaiter
+    {
+    public:
+        void notify(BenchEventType eventType, int changedCount)
+        {
+            {
+                std::lock_guard<std::mutex> lk(_eventCvMutex);
+                _lastNotifiedEventType.insert_or_assign(eventType, changedCount);
+            }
+            _eventCv.notify_all();
+        }
+
+        std::map<BenchEventType, int> waitParam(const std::set<BenchEventType> & eventTypes)
+        {
+            std::map<BenchEventType, int> toReturn;
+            std::unique_lock<std::mutex> lk(_eventCvMutex);
+            for (auto eventType : eventTypes)
+            {
+                int changedCount = -1;
+                auto it = _lastNotifiedEventType.find(eventType);
+                if (it != _lastNotifiedEventType.end())
+                    changedCount = it->second;
+                toReturn.insert(std::make_pair(eventType, changedCount));
+            }
+            return toReturn;
+        }
+
+        BenchEventType wait(std::map<BenchEventType, int> & eventTypes)
+        {
+            std::unique_lock<std::mutex> lk(_eventCvMutex);
+            BenchEventType notifiedEventType;
+            _eventCv.wait(lk, [eventTypes, &notifiedEventType, lastNotifiedEventType = std::ref(_lastNotifiedEventType)]{
+                for (auto eventType : eventTypes) {
+                    auto itFind = lastNotifiedEventType.get().find(eventType.first);
+                    if (   itFind != lastNotifiedEventType.get().end()
+                        && itFind->second > eventType.second)
+                    {
+                        itFind->second = eventType.second;
+                        notifiedEventType = eventType.first;
+                        return true;
+                    }
+                }
+                return false;
+            });
+            return notifiedEventType;
+        }
+
+    private:
+        std::mutex _eventCvMutex;
+        std::condition_variable _eventCv;
+        std::map<BenchEventType, int> _lastNotifiedEventType;
+    };
+
+    //! @brief Measure the latency between a notify and the wake up of the thread waiting for it, while
+    //! otherWaiterCount threads wait for other events notified at the same rate.
+    template<typename Dispatcher>
+    void wakeupLatencyBench(const std::string & name, std::size_t otherWaiterCount)
+    {
+        Dispatcher dispatcher;
+        std::atomic<bool> isRunning(true);
+        std::atomic<std::size_t> stoppedCount(0);
+        std::atomic<bool> isTargetWaiting(false);
+        std::atomic<std::chrono::steady_clock::time_point> notifyTime;
+        std::vector<std::chrono::nanoseconds> latencies;
+        latencies.reserve(WAKEUP_COUNT);
+
+        std::vector<std::thread> otherWaiters;
+        for (std::size_t i = 0; i < otherWaiterCount; i++)
+        {
+            auto eventType = static_cast<BenchEventType>(1 + i%(BENCH_EVENT_TYPE_COUNT-1));
+            otherWaiters.emplace_back([&dispatcher, &isRunning, &stoppedCount, eventType]{
+                while (isRunning)
+                {
+                    auto eventTypes = dispatcher.waitParam({eventType});
+                    dispatcher.wait(eventTypes);
+                }
+                stoppedCount++;
+            });
+        }
+        std::thread targetWaiter([&]{
+            for (std::size_t i = 0; i < WAKEUP_COUNT; i++)
+            {
+                auto eventTypes = dispatcher.waitParam({BenchEventType::TARGET});
+                isTargetWaiting = true;
+                dispatcher.wait(eventTypes);
+                latencies.push_back(std::chrono::steady_clock::now() - notifyTime.load());
+            }
+        });
+
+        // Notify every other events then the target one, as a sensor stream would do
+        for (int changedCount = 0; changedCount < static_cast<int>(WAKEUP_COUNT); changedCount++)
+        {
+            while (!isTargetWaiting)
+                std::this_thread::yield();
+            isTargetWaiting = false;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            for (std::size_t eventIndex = 1; eventIndex < BENCH_EVENT_TYPE_COUNT; eventIndex++)
+                dispatcher.notify(static_cast<BenchEventType>(eventIndex), changedCount);
+            notifyTime = std::chrono::steady_clock::now();
+            dispatcher.notify(BenchEventType::TARGET, changedCount);
+        }
+        targetWaiter.join();
+
+        // Release the other waiters
+        isRunning = false;
+        for (int changedCount = static_cast<int>(WAKEUP_COUNT); stoppedCount < otherWaiterCount; changedCount++)
+        {
+            for (std::size_t eventIndex = 1; eventIndex < BENCH_EVENT_TYPE_COUNT; eventIndex++)
+                dispatcher.notify(static_cast<BenchEventType>(eventIndex), changedCount);
+            std::this_thread::yield();
+        }
+        for (auto & otherWaiter : otherWaiters)
+            otherWaiter.join();
+
+        printPercentiles(name + "/" + std::to_string(otherWaiterCount), latencies);
+    }
+}
+
+void waitBench()
+{
+    for (std::size_t otherWaiterCount : {0, 4, 16, 64})
+    {
+        wakeupLatencyBench<LegacyEventWaiter>("wakeup/legacy", otherWaiterCount);
+        wakeupLatencyBench<EventDispatcher<BenchEventType, BENCH_EVENT_TYPE_COUNT>>("wakeup/eventDispatcher", otherWaiterCount);
+    }
+}
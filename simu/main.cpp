@@ -0,0 +1,96 @@
+#include "simuserver.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+    template<typename T>
+    T parse(const std::string & str)
+    {
+        std::istringstream iss(str);
+        iss.exceptions(std::istringstream::failbit);
+        T value;
+        iss >> value;
+        return value;
+    }
+
+    void printUsage(const char * programName)
+    {
+        std::cerr << "Usage: " << programName << " [--port tcpPort] [--rate notificationsPerSecond]"
+                  << " [--stream methodName:count:notificationsPerSecond]... [--drop ratio]" << std::endl;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    SimuServer::Config config;
+
+    try
+    {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        if (args.size()%2 != 0)
+            throw std::invalid_argument("Missing option value");
+        for (std::size_t i = 0; i < args.size(); i += 2)
+        {
+            if (args[i] == "--port")
+                config.tcpPort = parse<unsigned short>(args[i+1]);
+            else if (args[i] == "--rate")
+            {
+                double rate = parse<double>(args[i+1]);
+                for (auto & stream : config.streams)
+                    stream.rate = rate;
+            }
+            else if (args[i] == "--stream")
+            {
+                std::istringstream iss(args[i+1]);
+                std::string methodName, count, rate;
+                std::getline(iss, methodName, ':');
+                std::getline(iss, count, ':');
+                std::getline(iss, rate, ':');
+                bool isFound = false;
+                for (std::size_t streamIndex = 0; streamIndex < SimuServer::STREAM_COUNT; streamIndex++)
+                {
+                    if (methodName == SimuServer::streamMethodName(static_cast<SimuServer::Stream>(streamIndex)))
+                    {
+                        config.streams[streamIndex].count = parse<std::size_t>(count);
+                        config.streams[streamIndex].rate = parse<double>(rate);
+                        isFound = true;
+                    }
+                }
+                if (!isFound)
+                    throw std::invalid_argument(std::string("Unknown stream ") + methodName);
+            }
+            else if (args[i] == "--drop")
+            {
+                config.dropRatio = parse<double>(args[i+1]);
+                if (config.dropRatio < 0.0 || config.dropRatio > 1.0)
+                    throw std::invalid_argument(std::string("Invalid drop ratio ") + args[i+1]);
+            }
+            else
+                throw std::invalid_argument(std::string("Unknown option ") + args[i]);
+        }
+    }
+    catch (std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        SimuServer server(config);
+        server.run();
+    }
+    catch (std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "simurobot.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+
+SimuRobot::SimuRobot(const Config & config)
+    : _config(config)
+    , _x(config.arenaSize/2.0 + config.lineRadius)
+    , _y(config.arenaSize/2.0)
+    , _theta(std::numbers::pi/2.0)
+    , _rightPower(0.0)
+    , _leftPower(0.0)
+    , _rightDistance(0.0)
+    , _leftDistance(0.0)
+{}
+
+void SimuRobot::setRightPower(double power)
+{
+    _rightPower = std::clamp(power, -1.0, 1.0);
+}
+
+void SimuRobot::setLeftPower(double power)
+{
+    _leftPower = std::clamp(power, -1.0, 1.0);
+}
+
+void SimuRobot::step(double duration)
+{
+    double rightDistance = _rightPower*_config.maxSpeed*duration;
+    double leftDistance = _leftPower*_config.maxSpeed*duration;
+    double distance = (rightDistance + leftDistance)/2.0;
+    _theta += (rightDistance - leftDistance)/_config.wheelBase;
+    _x = std::clamp(_x + distance*std::cos(_theta), 0.0, _config.arenaSize);
+    _y = std::clamp(_y + distance*std::sin(_theta), 0.0, _config.arenaSize);
+    _rightDistance += std::abs(rightDistance);
+    _leftDistance += std::abs(leftDistance);
+}
+
+bool SimuRobot::lineTrackIsDetected(std::size_t index, std::size_t count) const
+{
+    return lineDistance(index, count) <= _config.lineWidth/2.0;
+}
+
+std::uint8_t SimuRobot::lineTrackValue(std::size_t index, std::size_t count) const
+{
+    double ratio = 1.0 - lineDistance(index, count)/_config.lineWidth;
+    return static_cast<std::uint8_t>(std::clamp(ratio, 0.0, 1.0)*255.0);
+}
+
+std::size_t SimuRobot::encoderWheelValue(std::size_t index) const
+{
+    return static_cast<std::size_t>((index == 0 ? _rightDistance : _leftDistance)*_config.ticksPerPixel);
+}
+
+std::size_t SimuRobot::irProximityDistance(std::size_t index, std::size_t count) const
+{
+    double distance = wallDistance(_theta + spreadAngle(index, count, std::numbers::pi/2.0));
+    return static_cast<std::size_t>(std::min(distance, _config.irMaxDistance));
+}
+
+std::size_t SimuRobot::ultrasoundDistance(std::size_t index, std::size_t count) const
+{
+    double distance = wallDistance(_theta + spreadAngle(index, count, std::numbers::pi/4.0));
+    return static_cast<std::size_t>(std::min(distance, _config.ultrasoundMaxDistance));
+}
+
+bool SimuRobot::switchIsDetected(std::size_t index, std::size_t count) const
+{
+    return wallDistance(_theta + spreadAngle(index, count, std::numbers::pi/2.0)) <= _config.switchDistance;
+}
+
+double SimuRobot::lineDistance(std::size_t index, std::size_t count) const
+{
+    // Sensors from right to left of the robot
+    double offset = (static_cast<double>(index) - (static_cast<double>(count) - 1.0)/2.0)*_config.lineTrackSpacing;
+    double x = _x + _config.lineTrackAhead*std::cos(_theta) - offset*std::sin(_theta);
+    double y = _y + _config.lineTrackAhead*std::sin(_theta) + offset*std::cos(_theta);
+    double center = _config.arenaSize/2.0;
+    return std::abs(std::hypot(x - center, y - center) - _config.lineRadius);
+}
+
+double SimuRobot::wallDistance(double angle) const
+{
+    double dx = std::cos(angle);
+    double dy = std::sin(angle);
+    double distance = std::numeric_limits<double>::infinity();
+    if (dx > 0.0)
+        distance = std::min(distance, (_config.arenaSize - _x)/dx);
+    else if (dx < 0.0)
+        distance = std::min(distance, -_x/dx);
+    if (dy > 0.0)
+        distance = std::min(distance, (_config.arenaSize - _y)/dy);
+    else if (dy < 0.0)
+        distance = std::min(distance, -_y/dy);
+    return distance;
+}
+
+double SimuRobot::spreadAngle(std::size_t index, std::size_t count, double spread)
+{
+    if (count <= 1)
+        return 0.0;
+    return spread/2.0 - spread*static_cast<double>(index)/static_cast<double>(count - 1);
+}
@@ -0,0 +1,70 @@
+#ifndef SIMUROBOT_HPP
+#define SIMUROBOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+//! @brief Differential drive robot moving on a map with a circular line drawn in a square arena.
+//! Distances are in pixel like on the real simulator.
+class SimuRobot
+{
+public:
+    struct Config
+    {
+        double arenaSize = 1000.0; //!< Width and height of the square arena
+        double lineRadius = 300.0; //!< The line is a circle centered in the arena
+        double lineWidth = 20.0;
+        double wheelBase = 50.0; //!< Distance between the two wheels
+        double maxSpeed = 200.0; //!< Wheel speed at power 1.0 (pixel per second)
+        double ticksPerPixel = 2.0; //!< Encoder wheel resolution
+        double lineTrackSpacing = 10.0; //!< Distance between two line track sensors
+        double lineTrackAhead = 20.0; //!< Distance of the line track sensors bar ahead of the wheels axis
+        double irMaxDistance = 300.0;
+        double ultrasoundMaxDistance = 500.0;
+        double switchDistance = 30.0; //!< Distance to a wall to press the switchs
+    };
+
+    SimuRobot(const Config & config);
+
+    //! @brief Set motor power (PWM between -1.0 and 1.0).
+    //! \{
+    void setRightPower(double power);
+    void setLeftPower(double power);
+    //! \}
+
+    //! @brief Move the robot during duration (in second).
+    void step(double duration);
+
+    //! @param index Sensor index in a bar of count sensors perpendicular to the robot direction.
+    //! \{
+    bool lineTrackIsDetected(std::size_t index, std::size_t count) const;
+    std::uint8_t lineTrackValue(std::size_t index, std::size_t count) const;
+    //! \}
+
+    //! @param index 0 for right wheel, 1 for left wheel.
+    std::size_t encoderWheelValue(std::size_t index) const;
+
+    //! @param index Sensor index in count sensors spread in front of the robot.
+    //! \{
+    std::size_t irProximityDistance(std::size_t index, std::size_t count) const;
+    std::size_t ultrasoundDistance(std::size_t index, std::size_t count) const;
+    bool switchIsDetected(std::size_t index, std::size_t count) const;
+    //! \}
+
+private:
+    double lineDistance(std::size_t index, std::size_t count) const;
+    double wallDistance(double angle) const;
+    static double spreadAngle(std::size_t index, std::size_t count, double spread);
+
+    Config _config;
+    double _x;
+    double _y;
+    double _theta;
+    double _rightPower;
+    double _leftPower;
+    double _rightDistance; //!< Absolute distance traveled by the right wheel
+    double _leftDistance; //!< Absolute distance traveled by the left wheel
+};
+
+#endif
@@ -0,0 +1,348 @@
+#include "simuserver.hpp"
+#include "wireprotocol.hpp"
+
+#include <asio/read_until.hpp>
+#include <asio/streambuf.hpp>
+#include <asio/write.hpp>
+#include <asio/buffer.hpp>
+#include <json/json.h>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+    void appendInteger(std::string & buffer, std::int64_t value)
+    {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+    }
+
+    //! @brief Sensor notification waiting to be encoded.
+    struct Notification
+    {
+        SimuServer::Stream stream;
+        std::size_t index;
+        std::int64_t value;
+        bool isBool;
+        int changedCount;
+    };
+
+    void appendNotification(std::string & buffer, const char * methodName, std::size_t index,
+            std::int64_t value, bool isBool, int changedCount)
+    {
+        buffer += "{\"jsonrpc\":\"2.0\",\"method\":\"";
+        buffer += methodName;
+        buffer += "\",\"params\":{\"index\":";
+        appendInteger(buffer, static_cast<std::int64_t>(index));
+        buffer += ",\"value\":";
+        if (isBool)
+            buffer += value != 0 ? "true" : "false";
+        else
+            appendInteger(buffer, value);
+        buffer += ",\"changedCount\":";
+        appendInteger(buffer, changedCount);
+        buffer += "}}\n";
+    }
+
+    //! @return The current value of one sensor of robot, boolean values are 0 or 1.
+    std::int64_t sensorValue(const SimuRobot & robot, SimuServer::Stream stream, std::size_t index, std::size_t count,
+            bool & isBool)
+    {
+        isBool = false;
+        switch (stream)
+        {
+            case SimuServer::Stream::IR_PROXIMITY_DISTANCE_DETECTED:
+                return static_cast<std::int64_t>(robot.irProximityDistance(index, count));
+            case SimuServer::Stream::LINE_TRACK_IS_DETECTED:
+                isBool = true;
+                return robot.lineTrackIsDetected(index, count);
+            case SimuServer::Stream::LINE_TRACK_VALUE:
+                return robot.lineTrackValue(index, count);
+            case SimuServer::Stream::ENCODER_WHEEL_VALUE:
+                return static_cast<std::int64_t>(robot.encoderWheelValue(index));
+            case SimuServer::Stream::SWITCH_IS_DETECTED:
+                isBool = true;
+                return robot.switchIsDetected(index, count);
+            case SimuServer::Stream::ULTRASOUND_DISTANCE_DETECTED:
+                return static_cast<std::int64_t>(robot.ultrasoundDistance(index, count));
+        }
+        return 0;
+    }
+}
+
+const char * SimuServer::streamMethodName(Stream stream)
+{
+    switch (stream)
+    {
+        case Stream::IR_PROXIMITY_DISTANCE_DETECTED:
+            return "irProximityDistanceDetected";
+        case Stream::LINE_TRACK_IS_DETECTED:
+            return "lineTrackIsDetected";
+        case Stream::LINE_TRACK_VALUE:
+            return "lineTrackValue";
+        case Stream::ENCODER_WHEEL_VALUE:
+            return "encoderWheelValue";
+        case Stream::SWITCH_IS_DETECTED:
+            return "switchIsDetected";
+        case Stream::ULTRASOUND_DISTANCE_DETECTED:
+            return "ultrasoundDistanceDetected";
+    }
+    throw std::invalid_argument(std::string("Cannot convert ")
+            + std::to_string(static_cast<int>(stream)) + " into SimuServer::Stream");
+}
+
+SimuServer::SimuServer(const Config & config)
+    : _config(config)
+    , _ioc()
+    , _acceptor(_ioc, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), config.tcpPort))
+{}
+
+void SimuServer::run()
+{
+    std::cout << "Listening on port " << _acceptor.local_endpoint().port() << " ..." << std::endl;
+    while (true)
+    {
+        asio::ip::tcp::socket socket(_ioc);
+        _acceptor.accept(socket);
+        std::cout << "Client connected from " << socket.remote_endpoint() << std::endl;
+        std::thread([this](asio::ip::tcp::socket clientSocket){
+            serveClient(std::move(clientSocket));
+        }, std::move(socket)).detach();
+    }
+}
+
+void SimuServer::serveClient(asio::ip::tcp::socket socket)
+{
+    SimuRobot robot(_config.robot);
+    std::mutex robotMutex;
+    std::mutex writeMutex;
+    bool isBinary = false; //!< Encoding of the messages sent, protected by writeMutex
+    std::atomic<bool> isConnected(true);
+    std::atomic<bool> isResendRequested(false); //!< Send all the sensors at the next iteration
+    std::array<std::vector<int>, STREAM_COUNT> changedCounts; //!< Protected by robotMutex
+    for (std::size_t streamIndex = 0; streamIndex < STREAM_COUNT; streamIndex++)
+        changedCounts[streamIndex].assign(_config.streams[streamIndex].count, 0);
+
+    // Execute one call and return its response, or null for a notification
+    auto callMethod = [&](const Json::Value & message, std::optional<bool> & isBinaryRequested){
+        std::string methodName = message["method"].asString();
+        const Json::Value & params = message["params"];
+        bool isKnownMethod = true;
+        Json::Value result;
+        if (methodName == WIRE_ENCODING_METHOD && params["encoding"] == "binary")
+            result = "binary";
+        else if (methodName == WIRE_ENCODING_METHOD && params["encoding"] == "json")
+            result = "json";
+        else
+        {
+            std::lock_guard<std::mutex> lk(robotMutex);
+            if (methodName == "setMotorsPower")
+            {
+                robot.setRightPower(params["rightValue"].asDouble());
+                robot.setLeftPower(params["leftValue"].asDouble());
+            }
+            else if (methodName == "setMotorPower" && params["motorIndex"].asString() == "RIGHT")
+                robot.setRightPower(params["value"].asDouble());
+            else if (methodName == "setMotorPower" && params["motorIndex"].asString() == "LEFT")
+                robot.setLeftPower(params["value"].asDouble());
+            else if (methodName == "resendSensors")
+                isResendRequested = true;
+            else if (methodName == "getSensorValues")
+            {
+                // Each value read is a new update of its index, sent with the next changed count
+                result = Json::Value(Json::arrayValue);
+                for (std::size_t streamIndex = 0; streamIndex < STREAM_COUNT; streamIndex++)
+                {
+                    Stream stream = static_cast<Stream>(streamIndex);
+                    if (params["method"] != streamMethodName(stream))
+                        continue;
+                    std::size_t count = _config.streams[streamIndex].count;
+                    for (std::size_t index = 0; index < count; index++)
+                    {
+                        bool isBool = false;
+                        std::int64_t value = sensorValue(robot, stream, index, count, isBool);
+                        Json::Value & indexedValue = result.append(Json::Value());
+                        indexedValue["index"] = static_cast<Json::UInt64>(index);
+                        indexedValue["value"] = isBool ? Json::Value(value != 0) : Json::Value(static_cast<Json::Int64>(value));
+                        indexedValue["changedCount"] = changedCounts[streamIndex][index]++;
+                    }
+                }
+            }
+            else
+                isKnownMethod = false;
+        }
+
+        if (methodName == WIRE_ENCODING_METHOD && result.isString())
+            isBinaryRequested = result == "binary";
+
+        Json::Value response;
+        if (!message.isMember("id"))
+            return response;
+        response["jsonrpc"] = "2.0";
+        response["id"] = message["id"];
+        if (isKnownMethod)
+            response["result"] = result;
+        else
+        {
+            response["error"]["code"] = -32601;
+            response["error"]["message"] = "Method not found";
+        }
+        return response;
+    };
+
+    // Receive motors commands and method calls
+    std::thread reader([&]{
+        asio::streambuf receiveStreambuf;
+        Json::CharReaderBuilder jsonCharReaderBuilder;
+        const std::unique_ptr<Json::CharReader> jsonReader(jsonCharReaderBuilder.newCharReader());
+        Json::StreamWriterBuilder jsonStreamWriterBuilder;
+        jsonStreamWriterBuilder["indentation"] = "";
+        while (isConnected)
+        {
+            asio::error_code ec;
+            std::size_t messageSize = asio::read_until(socket, receiveStreambuf, static_cast<char>(0x0A), ec);
+            if (ec)
+                break;
+            const char * messageBegin = static_cast<const char *>(receiveStreambuf.data().data());
+            Json::Value message;
+            JSONCPP_STRING errs;
+            bool isParsed = jsonReader->parse(messageBegin, messageBegin + messageSize - 1, &message, &errs);
+            receiveStreambuf.consume(messageSize);
+            if (!isParsed)
+            {
+                std::cerr << "Invalid message: " << errs << std::endl;
+                continue;
+            }
+
+            // Answer a batch with one array of the responses, without the notifications
+            std::optional<bool> isBinaryRequested;
+            Json::Value response;
+            if (message.isArray())
+            {
+                response = Json::Value(Json::arrayValue);
+                for (const Json::Value & call : message)
+                {
+                    Json::Value callResponse = callMethod(call, isBinaryRequested);
+                    if (!callResponse.isNull())
+                        response.append(callResponse);
+                }
+                if (response.empty())
+                    response = Json::Value();
+            }
+            else
+                response = callMethod(message, isBinaryRequested);
+            if (response.isNull())
+                continue;
+
+            std::string responseJson = Json::writeString(jsonStreamWriterBuilder, response);
+            std::string responseStr;
+            std::lock_guard<std::mutex> lk(writeMutex);
+            if (isBinary)
+                appendWireJsonFrame(responseStr, responseJson);
+            else
+                responseStr = responseJson + static_cast<char>(0x0A);
+            asio::write(socket, asio::buffer(responseStr), ec);
+            // The answer is the last message sent with the previous encoding
+            if (isBinaryRequested.has_value())
+                isBinary = isBinaryRequested.value();
+        }
+        isConnected = false;
+    });
+
+    // Send sensor notifications
+    using Clock = std::chrono::steady_clock;
+    std::string sendBuffer("{\"jsonrpc\":\"2.0\",\"method\":\"setIsReady\",\"params\":null}\n");
+    std::vector<Notification> notifications;
+    auto physicsPeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0/_config.physicsRate));
+    auto lastPhysicsTime = Clock::now();
+    std::array<Clock::duration, STREAM_COUNT> streamPeriods;
+    std::array<Clock::time_point, STREAM_COUNT> streamNextTimes;
+    std::minstd_rand dropRandom(std::random_device{}());
+    std::bernoulli_distribution dropDistribution(_config.dropRatio);
+    for (std::size_t streamIndex = 0; streamIndex < STREAM_COUNT; streamIndex++)
+    {
+        const StreamConfig & streamConfig = _config.streams[streamIndex];
+        streamPeriods[streamIndex] = streamConfig.rate > 0.0
+                ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0/streamConfig.rate))
+                : Clock::duration::max();
+        streamNextTimes[streamIndex] = lastPhysicsTime;
+    }
+    while (isConnected)
+    {
+        auto now = Clock::now();
+        std::unique_lock<std::mutex> robotLock(robotMutex);
+        while (lastPhysicsTime + physicsPeriod <= now)
+        {
+            robot.step(std::chrono::duration<double>(physicsPeriod).count());
+            lastPhysicsTime += physicsPeriod;
+        }
+
+        // Send every notification due, in one write
+        if (isResendRequested.exchange(false))
+            for (auto & streamNextTime : streamNextTimes)
+                streamNextTime = std::min(streamNextTime, now);
+        auto nextTime = lastPhysicsTime + physicsPeriod;
+        for (std::size_t streamIndex = 0; streamIndex < STREAM_COUNT; streamIndex++)
+        {
+            if (streamPeriods[streamIndex] == Clock::duration::max())
+                continue;
+            // Do not try to catch up more than one second late
+            if (streamNextTimes[streamIndex] + std::chrono::seconds(1) < now)
+                streamNextTimes[streamIndex] = now;
+            Stream stream = static_cast<Stream>(streamIndex);
+            std::size_t count = _config.streams[streamIndex].count;
+            for (; streamNextTimes[streamIndex] <= now; streamNextTimes[streamIndex] += streamPeriods[streamIndex])
+            {
+                for (std::size_t index = 0; index < count; index++)
+                {
+                    bool isBool = false;
+                    std::int64_t value = sensorValue(robot, stream, index, count, isBool);
+                    int changedCount = changedCounts[streamIndex][index]++;
+                    if (_config.dropRatio > 0.0 && dropDistribution(dropRandom))
+                        continue;
+                    notifications.push_back({stream, index, value, isBool, changedCount});
+                }
+            }
+            nextTime = std::min(nextTime, streamNextTimes[streamIndex]);
+        }
+        robotLock.unlock();
+
+        if (!sendBuffer.empty() || !notifications.empty())
+        {
+            // Encode under the write lock, the encoding can be changed by the reader until then
+            asio::error_code ec;
+            std::lock_guard<std::mutex> lk(writeMutex);
+            for (const Notification & notification : notifications)
+            {
+                if (isBinary)
+                    appendWireIndexedValueFrame(sendBuffer, indexedValueMethod(streamMethodName(notification.stream)).value(),
+                            static_cast<std::uint16_t>(notification.index), notification.changedCount, notification.value);
+                else
+                    appendNotification(sendBuffer, streamMethodName(notification.stream), notification.index,
+                            notification.value, notification.isBool, notification.changedCount);
+            }
+            notifications.clear();
+            asio::write(socket, asio::buffer(sendBuffer), ec);
+            if (ec)
+                break;
+            sendBuffer.clear();
+        }
+        std::this_thread::sleep_until(nextTime);
+    }
+
+    isConnected = false;
+    asio::error_code ec;
+    socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+    reader.join();
+    std::cout << "Client disconnected" << std::endl;
+}
@@ -0,0 +1,62 @@
+#ifndef SIMUSERVER_HPP
+#define SIMUSERVER_HPP
+
+#include "simurobot.hpp"
+
+#include <asio/ip/tcp.hpp>
+#include <asio/io_context.hpp>
+#include <array>
+#include <string>
+
+
+//! @brief JSON-RPC TCP server speaking the robot server protocol, each client drives its own SimuRobot.
+class SimuServer
+{
+public:
+    enum class Stream
+    {
+        IR_PROXIMITY_DISTANCE_DETECTED,
+        LINE_TRACK_IS_DETECTED,
+        LINE_TRACK_VALUE,
+        ENCODER_WHEEL_VALUE,
+        SWITCH_IS_DETECTED,
+        ULTRASOUND_DISTANCE_DETECTED
+    };
+    static constexpr std::size_t STREAM_COUNT = 6;
+
+    //! @brief Notification stream of one sensor family.
+    struct StreamConfig
+    {
+        std::size_t count; //!< Number of sensor index
+        double rate; //!< Notifications per second for each sensor index, 0 to disable
+    };
+
+    struct Config
+    {
+        unsigned short tcpPort = 6543;
+        double physicsRate = 1000.0; //!< Robot moves per second
+        SimuRobot::Config robot;
+        std::array<StreamConfig, STREAM_COUNT> streams = {{{3, 100.0}, {1, 100.0}, {1, 100.0}, {2, 100.0}, {1, 100.0}, {1, 100.0}}};
+        double dropRatio = 0.0; //!< Ratio of sensor notifications not sent, as a lossy robot server would do
+    };
+
+    //! @return The JSON-RPC method name of this stream notifications.
+    static const char * streamMethodName(Stream stream);
+
+    SimuServer(const Config & config);
+
+    //! @brief Accept clients forever, each one in its own thread.
+    void run();
+
+private:
+    SimuServer(const SimuServer &) = delete;
+    SimuServer & operator=(const SimuServer &) = delete;
+
+    void serveClient(asio::ip::tcp::socket socket);
+
+    Config _config;
+    asio::io_context _ioc;
+    asio::ip::tcp::acceptor _acceptor;
+};
+
+#endif
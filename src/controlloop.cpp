@@ -0,0 +1,108 @@
+#include "controlloop.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <cerrno>
+#endif
+
+
+ControlLoop::ControlLoop(Robot & robot, const Config & config, const Step & step)
+    : _robot(robot)
+    , _config(config)
+    , _step(step)
+    , _isStopping(false)
+    , _isSchedulingApplied(false)
+    , _tickCount(0)
+    , _overrunCount(0)
+    , _missedTickCount(0)
+    , _jitter()
+    , _stepDuration()
+    , _thread()
+{}
+
+ControlLoop::~ControlLoop()
+{
+    stop();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void ControlLoop::start()
+{
+    _isStopping = false;
+    _thread = std::thread([](ControlLoop * thus){thus->run();}, this);
+}
+
+void ControlLoop::run()
+{
+    _isSchedulingApplied = applyScheduling();
+
+    auto deadline = std::chrono::steady_clock::now() + _config.period;
+    while (!_isStopping)
+    {
+        sleepUntil(deadline);
+        auto tickBegin = std::chrono::steady_clock::now();
+        _jitter.record(tickBegin - deadline);
+
+        _step(_robot.snapshot());
+
+        auto tickEnd = std::chrono::steady_clock::now();
+        _stepDuration.record(tickEnd - tickBegin);
+        _tickCount++;
+
+        // Skip the deadlines already passed
+        deadline += _config.period;
+        if (tickEnd > deadline)
+        {
+            _overrunCount++;
+            auto missedTicks = (tickEnd - deadline)/_config.period + 1;
+            _missedTickCount += static_cast<std::uint64_t>(missedTicks);
+            deadline += missedTicks*_config.period;
+        }
+    }
+}
+
+void ControlLoop::stop()
+{
+    _isStopping = true;
+}
+
+bool ControlLoop::applyScheduling()
+{
+    bool isApplied = true;
+#ifdef __linux__
+    if (_config.cpu.has_value())
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(_config.cpu.value(), &cpuSet);
+        isApplied &= pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+    }
+    if (_config.realTimePriority.has_value())
+    {
+        sched_param schedParam = {};
+        schedParam.sched_priority = _config.realTimePriority.value();
+        // Usually not permitted without CAP_SYS_NICE, the loop then runs with the default scheduling
+        isApplied &= pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam) == 0;
+    }
+#else
+    isApplied = !_config.cpu.has_value() && !_config.realTimePriority.has_value();
+#endif
+    return isApplied;
+}
+
+void ControlLoop::sleepUntil(std::chrono::steady_clock::time_point deadline)
+{
+#ifdef __linux__
+    // steady_clock is CLOCK_MONOTONIC, sleep on the absolute deadline to avoid any drift
+    auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+    timespec deadlineSpec;
+    deadlineSpec.tv_sec = static_cast<time_t>(sinceEpoch.count()/1000000000);
+    deadlineSpec.tv_nsec = static_cast<long>(sinceEpoch.count()%1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadlineSpec, nullptr) == EINTR);
+#else
+    std::this_thread::sleep_until(deadline);
+#endif
+}
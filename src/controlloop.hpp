@@ -0,0 +1,79 @@
+#ifndef CONTROLLOOP_HPP
+#define CONTROLLOOP_HPP
+
+#include "robot.hpp"
+#include "latencyhistogram.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <thread>
+
+
+//! @brief Call a step function at a fixed period with a consistent snapshot of the robot sensors.
+//! Ticks are scheduled on absolute deadlines, so the period does not drift with the step duration or
+//! the notification traffic. A step ending after the next deadline is an overrun, and the deadlines
+//! already passed are skipped and counted as missed.
+class ControlLoop
+{
+public:
+    struct Config
+    {
+        std::chrono::nanoseconds period = std::chrono::milliseconds(1);
+        std::optional<int> cpu; //!< Pin the loop thread to this core if set (Linux only)
+        std::optional<int> realTimePriority; //!< Use SCHED_FIFO with this priority if set and permitted (Linux only)
+    };
+
+    using Step = std::function<void(const Robot::Snapshot & snapshot)>;
+
+    ControlLoop(Robot & robot, const Config & config, const Step & step);
+
+    //! @brief Stop and wait the loop thread if started.
+    ~ControlLoop();
+
+    //! @brief Run the loop in a new thread.
+    void start();
+
+    //! @brief Run the loop in the current thread until stop is called.
+    void run();
+
+    //! @brief Ask the loop to stop after its current tick, can be called from any thread.
+    void stop();
+
+    //! @return True if the loop thread has been pinned and set to real time as configured.
+    //! Only meaningful once the loop is running.
+    bool isSchedulingApplied() const {return _isSchedulingApplied;}
+
+    //! @name Statistics, can be read while the loop is running
+    //! \{
+    std::uint64_t tickCount() const {return _tickCount;}
+    std::uint64_t overrunCount() const {return _overrunCount;}
+    std::uint64_t missedTickCount() const {return _missedTickCount;}
+    //! @return Delay between each deadline and the start of its tick.
+    const LatencyHistogram & jitter() const {return _jitter;}
+    //! @return Duration of each step, to size the period against the CPU budget.
+    const LatencyHistogram & stepDuration() const {return _stepDuration;}
+    //! \}
+
+private:
+    ControlLoop(const ControlLoop &) = delete;
+    ControlLoop & operator=(const ControlLoop &) = delete;
+
+    bool applyScheduling();
+    static void sleepUntil(std::chrono::steady_clock::time_point deadline);
+
+    Robot & _robot;
+    Config _config;
+    Step _step;
+    std::atomic<bool> _isStopping;
+    std::atomic<bool> _isSchedulingApplied;
+    std::atomic<std::uint64_t> _tickCount;
+    std::atomic<std::uint64_t> _overrunCount;
+    std::atomic<std::uint64_t> _missedTickCount;
+    LatencyHistogram _jitter;
+    LatencyHistogram _stepDuration;
+    std::thread _thread;
+};
+
+#endif
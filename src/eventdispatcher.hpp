@@ -0,0 +1,247 @@
+#ifndef EVENTDISPATCHER_HPP
+#define EVENTDISPATCHER_HPP
+
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+
+//! @brief Wake up threads waiting for events.
+//! Each waiter is registered only in the lists of the events it waits for, and has its own condition
+//! variable, so a notify only wakes the waiters of this event.
+//! @param EVENT_TYPE_COUNT Number of values of EventType, which must start from 0 and be contiguous.
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+class EventDispatcher
+{
+public:
+    EventDispatcher() : _mutex(), _changedCounts(), _waiters(), _asyncWaiters(), _nextAsyncWaitId(0) {_changedCounts.fill(-1);}
+
+    //! @brief Record the new changed count of this event and wake up its waiters.
+    void notify(EventType eventType, int changedCount);
+
+    //! @return The last changed count of each event type (-1 if never notified), to give to wait.
+    std::map<EventType, int> waitParam(const std::set<EventType> & eventTypes);
+
+    //! @brief Wait until one of the event has a changed count greater than the given one.
+    //! The changed count of the received event is updated to its last value, to wait again for the next one.
+    //! @return The received event
+    EventType wait(std::map<EventType, int> & eventTypes);
+
+    //! @brief Wait until one of the event has a changed count greater than the given one or timeout.
+    //! @return The received event or an empty value if timeout
+    template<typename _Rep, typename _Period>
+    std::optional<EventType> wait(std::map<EventType, int> & eventTypes, const std::chrono::duration<_Rep, _Period> & duration);
+
+    //! @brief Call callback once, when one of the event has a changed count greater than the given one.
+    //! @param callback Called from the notifying thread (or this one if already notified) with the
+    //! dispatcher locked: it must be short and must not call the dispatcher. Called with an empty
+    //! value by cancelAsyncWaits.
+    //! @return An id to give to cancelAsyncWait.
+    using AsyncWaitCallback = std::function<void(std::optional<EventType> notifiedEventType)>;
+    std::uint64_t asyncWait(const std::map<EventType, int> & eventTypes, const AsyncWaitCallback & callback);
+
+    //! @brief Remove an async wait not notified yet, its callback will never be called.
+    void cancelAsyncWait(std::uint64_t asyncWaitId);
+
+    //! @brief Remove all the async waits not notified yet, calling their callback with an empty value.
+    void cancelAsyncWaits();
+
+private:
+    EventDispatcher(const EventDispatcher &) = delete;
+    EventDispatcher & operator=(const EventDispatcher &) = delete;
+
+    struct Waiter
+    {
+        Waiter(const std::map<EventType, int> & eventTypesParam) : cv(), eventTypes(eventTypesParam), notifiedEventType(), asyncWaitId(), callback() {}
+        std::condition_variable cv;
+        const std::map<EventType, int> & eventTypes;
+        std::optional<EventType> notifiedEventType;
+        std::optional<std::uint64_t> asyncWaitId; //!< Only for async waiter
+        AsyncWaitCallback callback; //!< Only for async waiter
+    };
+
+    struct AsyncWaiter
+    {
+        AsyncWaiter(const std::map<EventType, int> & eventTypesParam) : eventTypes(eventTypesParam), waiter(eventTypes) {}
+        std::map<EventType, int> eventTypes;
+        Waiter waiter;
+    };
+
+    std::optional<EventType> findNotified(const std::map<EventType, int> & eventTypes) const;
+    void registerWaiter(Waiter & waiter);
+    void unregisterWaiter(Waiter & waiter);
+    EventType consume(std::map<EventType, int> & eventTypes, EventType notifiedEventType) const;
+
+    std::mutex _mutex;
+    std::array<int, EVENT_TYPE_COUNT> _changedCounts;
+    std::array<std::vector<Waiter *>, EVENT_TYPE_COUNT> _waiters;
+    std::map<std::uint64_t, std::unique_ptr<AsyncWaiter>> _asyncWaiters;
+    std::uint64_t _nextAsyncWaitId;
+};
+
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+void EventDispatcher<EventType, EVENT_TYPE_COUNT>::notify(EventType eventType, int changedCount)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    std::size_t eventIndex = static_cast<std::size_t>(eventType);
+    _changedCounts[eventIndex] = changedCount;
+    std::vector<std::uint64_t> notifiedAsyncWaitIds;
+    for (Waiter * waiter : _waiters[eventIndex])
+    {
+        if (!waiter->notifiedEventType.has_value() && changedCount > waiter->eventTypes.at(eventType))
+        {
+            waiter->notifiedEventType = eventType;
+            if (waiter->asyncWaitId.has_value())
+                notifiedAsyncWaitIds.push_back(waiter->asyncWaitId.value());
+            else
+                // Notify under lock: the waiter, and so its condition variable, can be destroyed as soon as unlocked
+                waiter->cv.notify_one();
+        }
+    }
+
+    // Async waiters are completed here as there is no waiting thread to do it
+    for (std::uint64_t asyncWaitId : notifiedAsyncWaitIds)
+    {
+        auto it = _asyncWaiters.find(asyncWaitId);
+        Waiter & waiter = it->second->waiter;
+        unregisterWaiter(waiter);
+        waiter.callback(eventType);
+        _asyncWaiters.erase(it);
+    }
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+std::map<EventType, int> EventDispatcher<EventType, EVENT_TYPE_COUNT>::waitParam(const std::set<EventType> & eventTypes)
+{
+    std::map<EventType, int> toReturn;
+    std::lock_guard<std::mutex> lk(_mutex);
+    for (auto eventType : eventTypes)
+        toReturn.insert(std::make_pair(eventType, _changedCounts[static_cast<std::size_t>(eventType)]));
+    return toReturn;
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+EventType EventDispatcher<EventType, EVENT_TYPE_COUNT>::wait(std::map<EventType, int> & eventTypes)
+{
+    std::unique_lock<std::mutex> lk(_mutex);
+    auto notifiedEventType = findNotified(eventTypes);
+    if (!notifiedEventType.has_value())
+    {
+        Waiter waiter(eventTypes);
+        registerWaiter(waiter);
+        waiter.cv.wait(lk, [&waiter]{return waiter.notifiedEventType.has_value();});
+        unregisterWaiter(waiter);
+        notifiedEventType = waiter.notifiedEventType;
+    }
+    return consume(eventTypes, notifiedEventType.value());
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+template<typename _Rep, typename _Period>
+std::optional<EventType> EventDispatcher<EventType, EVENT_TYPE_COUNT>::wait(std::map<EventType, int> & eventTypes,
+        const std::chrono::duration<_Rep, _Period> & duration)
+{
+    std::unique_lock<std::mutex> lk(_mutex);
+    auto notifiedEventType = findNotified(eventTypes);
+    if (!notifiedEventType.has_value())
+    {
+        Waiter waiter(eventTypes);
+        registerWaiter(waiter);
+        waiter.cv.wait_for(lk, duration, [&waiter]{return waiter.notifiedEventType.has_value();});
+        unregisterWaiter(waiter);
+        notifiedEventType = waiter.notifiedEventType;
+        if (!notifiedEventType.has_value())
+            return {};
+    }
+    return consume(eventTypes, notifiedEventType.value());
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+std::uint64_t EventDispatcher<EventType, EVENT_TYPE_COUNT>::asyncWait(const std::map<EventType, int> & eventTypes,
+        const AsyncWaitCallback & callback)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    std::uint64_t asyncWaitId = _nextAsyncWaitId++;
+    auto notifiedEventType = findNotified(eventTypes);
+    if (notifiedEventType.has_value())
+    {
+        callback(notifiedEventType.value());
+        return asyncWaitId;
+    }
+    auto asyncWaiter = std::make_unique<AsyncWaiter>(eventTypes);
+    asyncWaiter->waiter.asyncWaitId = asyncWaitId;
+    asyncWaiter->waiter.callback = callback;
+    registerWaiter(asyncWaiter->waiter);
+    _asyncWaiters.insert(std::make_pair(asyncWaitId, std::move(asyncWaiter)));
+    return asyncWaitId;
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+void EventDispatcher<EventType, EVENT_TYPE_COUNT>::cancelAsyncWait(std::uint64_t asyncWaitId)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    auto it = _asyncWaiters.find(asyncWaitId);
+    if (it == _asyncWaiters.end())
+        return;
+    unregisterWaiter(it->second->waiter);
+    _asyncWaiters.erase(it);
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+void EventDispatcher<EventType, EVENT_TYPE_COUNT>::cancelAsyncWaits()
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    for (auto & asyncWaiter : _asyncWaiters)
+    {
+        Waiter & waiter = asyncWaiter.second->waiter;
+        unregisterWaiter(waiter);
+        waiter.callback(std::nullopt);
+    }
+    _asyncWaiters.clear();
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+std::optional<EventType> EventDispatcher<EventType, EVENT_TYPE_COUNT>::findNotified(const std::map<EventType, int> & eventTypes) const
+{
+    for (auto eventType : eventTypes)
+        if (_changedCounts[static_cast<std::size_t>(eventType.first)] > eventType.second)
+            return eventType.first;
+    return {};
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+void EventDispatcher<EventType, EVENT_TYPE_COUNT>::registerWaiter(Waiter & waiter)
+{
+    for (auto eventType : waiter.eventTypes)
+        _waiters[static_cast<std::size_t>(eventType.first)].push_back(&waiter);
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+void EventDispatcher<EventType, EVENT_TYPE_COUNT>::unregisterWaiter(Waiter & waiter)
+{
+    for (auto eventType : waiter.eventTypes)
+    {
+        auto & waiters = _waiters[static_cast<std::size_t>(eventType.first)];
+        waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+    }
+}
+
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+EventType EventDispatcher<EventType, EVENT_TYPE_COUNT>::consume(std::map<EventType, int> & eventTypes, EventType notifiedEventType) const
+{
+    // Move the waiter to the last changed count, without touching the shared one seen by the other waiters
+    eventTypes.at(notifiedEventType) = _changedCounts[static_cast<std::size_t>(notifiedEventType)];
+    return notifiedEventType;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "fleet.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+
+Fleet::Fleet(std::size_t threadCount)
+    : _ioContext()
+    , _workGuard(asio::make_work_guard(_ioContext))
+    , _robots()
+    , _threads()
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t i = 0; i < threadCount; i++)
+        _threads.emplace_back([](Fleet * thus){thus->run();}, this);
+}
+
+Fleet::~Fleet()
+{
+    // The robots wait for their pending operations, so the threads must still run the context
+    _robots.clear();
+    _workGuard.reset();
+    _ioContext.stop();
+    for (auto & thread : _threads)
+        thread.join();
+}
+
+Robot & Fleet::addRobot(const std::string & hostIpAddress, uint16_t tcpPort)
+{
+    _robots.push_back(std::make_unique<Robot>(_ioContext, hostIpAddress, tcpPort));
+    return *_robots.back();
+}
+
+void Fleet::run()
+{
+    // An exception thrown by the handles of one robot must not stop the others
+    while (true)
+    {
+        try
+        {
+            _ioContext.run();
+            return;
+        }
+        catch (std::exception & e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef FLEET_HPP
+#define FLEET_HPP
+
+#include "robot.hpp"
+
+#include <asio/executor_work_guard.hpp>
+#include <asio/io_context.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+//! @brief Many robots sharing one io_context run by a pool of threads.
+//! The robots have no dedicated thread: their notifications are received with asynchronous reads and
+//! their handles, motors commands and coroutines run on any thread of the pool, so the number of
+//! threads follows the cores and not the connections.
+class Fleet
+{
+public:
+    //! @param threadCount Number of threads running the io_context, the hardware concurrency if 0.
+    Fleet(std::size_t threadCount = 0);
+
+    //! @brief Close all the robot connexions then stop the threads.
+    ~Fleet();
+
+    //! @brief Connect a new robot to a robot server (simu or reel).
+    //! @warning Not thread safe with the other calls of this fleet.
+    Robot & addRobot(const std::string & hostIpAddress, uint16_t tcpPort);
+
+    std::size_t size() const {return _robots.size();}
+    Robot & operator[](std::size_t index) {return *_robots.at(index);}
+
+    //! @brief Context shared by the robots, on which their coroutines can be spawned.
+    asio::io_context & ioContext() {return _ioContext;}
+
+    std::size_t threadCount() const {return _threads.size();}
+
+private:
+    Fleet(const Fleet &) = delete;
+    Fleet & operator=(const Fleet &) = delete;
+
+    void run();
+
+    asio::io_context _ioContext;
+    asio::executor_work_guard<asio::io_context::executor_type> _workGuard;
+    std::vector<std::unique_ptr<Robot>> _robots;
+    std::vector<std::thread> _threads;
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "indexedvaluenotification.hpp"
+
+
+namespace
+{
+    class Cursor
+    {
+    public:
+        Cursor(const char * begin, const char * end) : _current(begin), _end(end) {}
+
+        void skipSpaces()
+        {
+            while (_current != _end && (*_current == ' ' || *_current == '\t' || *_current == '\r' || *_current == '\n'))
+                _current++;
+        }
+
+        bool consume(char c)
+        {
+            skipSpaces();
+            if (_current == _end || *_current != c)
+                return false;
+            _current++;
+            return true;
+        }
+
+        bool peek(char c)
+        {
+            skipSpaces();
+            return _current != _end && *_current == c;
+        }
+
+        bool readString(std::string_view & str)
+        {
+            if (!consume('"'))
+                return false;
+            const char * begin = _current;
+            while (_current != _end && *_current != '"')
+            {
+                // Escaped strings are left to the generic parser
+                if (*_current == '\\')
+                    return false;
+                _current++;
+            }
+            if (_current == _end)
+                return false;
+            str = std::string_view(begin, _current - begin);
+            _current++;
+            return true;
+        }
+
+        bool readInteger(std::int64_t & value)
+        {
+            skipSpaces();
+            bool isNegative = false;
+            if (_current != _end && *_current == '-')
+            {
+                isNegative = true;
+                _current++;
+            }
+            if (_current == _end || *_current < '0' || *_current > '9')
+                return false;
+            std::int64_t result = 0;
+            int digitCount = 0;
+            while (_current != _end && *_current >= '0' && *_current <= '9')
+            {
+                // Up to 18 digits cannot overflow, the longer integers are left to the generic parser
+                if (++digitCount > MAX_DIGIT_COUNT)
+                    return false;
+                result = result*10 + (*_current - '0');
+                _current++;
+            }
+            // Floats are left to the generic parser
+            if (_current != _end && (*_current == '.' || *_current == 'e' || *_current == 'E'))
+                return false;
+            value = isNegative ? -result : result;
+            return true;
+        }
+
+        bool readIntegerOrBoolean(std::int64_t & value)
+        {
+            skipSpaces();
+            if (readLiteral("true"))
+            {
+                value = 1;
+                return true;
+            }
+            if (readLiteral("false"))
+            {
+                value = 0;
+                return true;
+            }
+            return readInteger(value);
+        }
+
+        bool isEnd()
+        {
+            skipSpaces();
+            return _current == _end;
+        }
+
+    private:
+        bool readLiteral(std::string_view literal)
+        {
+            if (static_cast<std::size_t>(_end - _current) < literal.size()
+                    || std::string_view(_current, literal.size()) != literal)
+                return false;
+            _current += literal.size();
+            return true;
+        }
+
+        static constexpr int MAX_DIGIT_COUNT = 18; //!< 10^18 - 1 fits in an int64, as its opposite
+
+        const char * _current;
+        const char * _end;
+    };
+
+    bool parseParams(Cursor & cursor, IndexedValueNotification & notification)
+    {
+        bool hasIndex = false, hasValue = false, hasChangedCount = false;
+        if (!cursor.consume('{'))
+            return false;
+        do
+        {
+            std::string_view key;
+            std::int64_t value;
+            if (!cursor.readString(key) || !cursor.consume(':'))
+                return false;
+            if (key == "index")
+            {
+                if (!cursor.readInteger(value) || value < 0)
+                    return false;
+                notification.index = static_cast<std::size_t>(value);
+                hasIndex = true;
+            }
+            else if (key == "value")
+            {
+                if (!cursor.readIntegerOrBoolean(value))
+                    return false;
+                notification.value = value;
+                hasValue = true;
+            }
+            else if (key == "changedCount")
+            {
+                if (!cursor.readInteger(value))
+                    return false;
+                notification.changedCount = static_cast<int>(value);
+                hasChangedCount = true;
+            }
+            else
+                return false;
+        } while (cursor.consume(','));
+        return cursor.consume('}') && hasIndex && hasValue && hasChangedCount;
+    }
+}
+
+bool parseIndexedValueNotification(const char * begin, const char * end, IndexedValueNotification & notification)
+{
+    Cursor cursor(begin, end);
+    bool hasMethod = false, hasParams = false;
+    if (!cursor.consume('{'))
+        return false;
+    if (cursor.peek('}'))
+        return false;
+    do
+    {
+        std::string_view key;
+        if (!cursor.readString(key) || !cursor.consume(':'))
+            return false;
+        if (key == "jsonrpc")
+        {
+            std::string_view version;
+            if (!cursor.readString(version))
+                return false;
+        }
+        else if (key == "method")
+        {
+            std::string_view methodName;
+            if (!cursor.readString(methodName))
+                return false;
+            auto method = indexedValueMethod(methodName);
+            if (!method.has_value())
+                return false;
+            notification.method = method.value();
+            hasMethod = true;
+        }
+        else if (key == "params")
+        {
+            if (!parseParams(cursor, notification))
+                return false;
+            hasParams = true;
+        }
+        // Method responses ("id") and any other member are left to the generic parser
+        else
+            return false;
+    } while (cursor.consume(','));
+    return cursor.consume('}') && cursor.isEnd() && hasMethod && hasParams;
+}
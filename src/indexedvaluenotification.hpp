@@ -0,0 +1,104 @@
+#ifndef INDEXEDVALUENOTIFICATION_HPP
+#define INDEXEDVALUENOTIFICATION_HPP
+
+#include <string_view>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+
+
+//! @brief Sensor notifications with the fixed shape params, known at compile time.
+//! Their value is also their method id in the binary wire encoding.
+enum class IndexedValueMethod : std::uint8_t
+{
+    IR_PROXIMITY_DISTANCE_DETECTED,
+    LINE_TRACK_IS_DETECTED,
+    LINE_TRACK_VALUE,
+    ENCODER_WHEEL_VALUE,
+    SWITCH_IS_DETECTED,
+    ULTRASOUND_DISTANCE_DETECTED
+};
+constexpr std::size_t INDEXED_VALUE_METHOD_COUNT = static_cast<std::size_t>(IndexedValueMethod::ULTRASOUND_DISTANCE_DETECTED) + 1;
+
+constexpr std::string_view INDEXED_VALUE_METHOD_NAMES[INDEXED_VALUE_METHOD_COUNT] = {"irProximityDistanceDetected",
+        "lineTrackIsDetected", "lineTrackValue", "encoderWheelValue", "switchIsDetected", "ultrasoundDistanceDetected"};
+
+constexpr std::string_view indexedValueMethodName(IndexedValueMethod method)
+{
+    return INDEXED_VALUE_METHOD_NAMES[static_cast<std::size_t>(method)];
+}
+
+//! @brief Find a sensor notification from its JSON-RPC method name with one switch and one compare:
+//! all the method names have a different length, which is a perfect hash of them.
+//! @return The method or an empty value if methodName is not a sensor notification.
+constexpr std::optional<IndexedValueMethod> indexedValueMethod(std::string_view methodName)
+{
+    IndexedValueMethod method;
+    switch (methodName.size())
+    {
+        case indexedValueMethodName(IndexedValueMethod::IR_PROXIMITY_DISTANCE_DETECTED).size():
+            method = IndexedValueMethod::IR_PROXIMITY_DISTANCE_DETECTED;
+            break;
+        case indexedValueMethodName(IndexedValueMethod::LINE_TRACK_IS_DETECTED).size():
+            method = IndexedValueMethod::LINE_TRACK_IS_DETECTED;
+            break;
+        case indexedValueMethodName(IndexedValueMethod::LINE_TRACK_VALUE).size():
+            method = IndexedValueMethod::LINE_TRACK_VALUE;
+            break;
+        case indexedValueMethodName(IndexedValueMethod::ENCODER_WHEEL_VALUE).size():
+            method = IndexedValueMethod::ENCODER_WHEEL_VALUE;
+            break;
+        case indexedValueMethodName(IndexedValueMethod::SWITCH_IS_DETECTED).size():
+            method = IndexedValueMethod::SWITCH_IS_DETECTED;
+            break;
+        case indexedValueMethodName(IndexedValueMethod::ULTRASOUND_DISTANCE_DETECTED).size():
+            method = IndexedValueMethod::ULTRASOUND_DISTANCE_DETECTED;
+            break;
+        default:
+            return {};
+    }
+    if (methodName != indexedValueMethodName(method))
+        return {};
+    return method;
+}
+
+namespace indexedvaluenotification_detail
+{
+    constexpr bool isIndexedValueMethodLookupValid()
+    {
+        for (std::size_t methodIndex = 0; methodIndex < INDEXED_VALUE_METHOD_COUNT; methodIndex++)
+            if (indexedValueMethod(INDEXED_VALUE_METHOD_NAMES[methodIndex]) != static_cast<IndexedValueMethod>(methodIndex))
+                return false;
+        return !indexedValueMethod("setIsReady").has_value();
+    }
+    static_assert(isIndexedValueMethodLookupValid(), "Each sensor notification name must have a different length");
+}
+
+//! @brief Decoded fields of the fixed shape sensor notification
+//! {"jsonrpc":"2.0","method":"...","params":{"index":...,"value":...,"changedCount":...}}
+struct IndexedValueNotification
+{
+    IndexedValueMethod method;
+    std::size_t index;
+    std::int64_t value; //!< Boolean values are decoded as 0 or 1
+    int changedCount;
+    std::chrono::steady_clock::time_point receiveTime; //!< When the message has been read from the socket
+    std::chrono::steady_clock::time_point parseTime; //!< When the message has been parsed
+};
+
+//! @brief Receive every sensor notification, whatever its method, without any lookup by name.
+class IndexedValueNotificationReceiver
+{
+public:
+    virtual ~IndexedValueNotificationReceiver() {}
+    virtual void receiveIndexedValueNotification(const IndexedValueNotification & notification) = 0;
+};
+
+//! @brief Parse a sensor notification without building a Json::Value.
+//! Only accept the exact fixed shape (no escaped string, no float, no extra member) of a method of
+//! IndexedValueMethod, any other message must be parsed with the generic json parser.
+//! @return True if the message has been decoded in notification.
+bool parseIndexedValueNotification(const char * begin, const char * end, IndexedValueNotification & notification);
+
+#endif
@@ -9,29 +9,143 @@
 #include <asio/read_until.hpp>
 #include <asio/read.hpp>
 #include <asio/buffer.hpp>
+#include <asio/system_error.hpp>
+#include <asio/async_result.hpp>
+#include <asio/post.hpp>
+#include <asio/bind_executor.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+#include <span>
 #include <thread>
+#include <algorithm>
+#include <stdexcept>
 
 
+namespace
+{
+    //! @return A response handle setting promise with the "result" member of the response, or with an
+    //! exception if the response contains an "error" member.
+    JsonRpcTcpClient::MethodResponseHandle resultHandle(const std::shared_ptr<std::promise<Json::Value>> & promise)
+    {
+        return [promise](const Json::Value & responseJson){
+            if (responseJson.isMember("error"))
+                promise->set_exception(std::make_exception_ptr(std::runtime_error(
+                        responseJson["error"]["message"].asString())));
+            else
+                promise->set_value(responseJson["result"]);
+        };
+    }
+}
+
 JsonRpcTcpClient::JsonRpcTcpClient(const std::string & hostIpAddress, unsigned short tcpPort)
-    : _ioc()
-    , _socket(_ioc)
+    : JsonRpcTcpClient(hostIpAddress, tcpPort, ConnectionConfig())
+{}
+
+JsonRpcTcpClient::JsonRpcTcpClient(const std::string & hostIpAddress, unsigned short tcpPort, const ConnectionConfig & connectionConfig)
+    : JsonRpcTcpClient(std::make_unique<asio::io_context>(), nullptr, hostIpAddress, tcpPort, connectionConfig)
+{}
+
+JsonRpcTcpClient::JsonRpcTcpClient(asio::io_context & ioContext, const std::string & hostIpAddress, unsigned short tcpPort)
+    : JsonRpcTcpClient(ioContext, hostIpAddress, tcpPort, ConnectionConfig())
+{}
+
+JsonRpcTcpClient::JsonRpcTcpClient(asio::io_context & ioContext, const std::string & hostIpAddress, unsigned short tcpPort,
+        const ConnectionConfig & connectionConfig)
+    : JsonRpcTcpClient(nullptr, &ioContext, hostIpAddress, tcpPort, connectionConfig)
+{}
+
+JsonRpcTcpClient::JsonRpcTcpClient(std::unique_ptr<asio::io_context> ownedIoContext, asio::io_context * sharedIoContext,
+        const std::string & hostIpAddress, unsigned short tcpPort, const ConnectionConfig & connectionConfig)
+    : _ownedIoc(std::move(ownedIoContext))
+    , _ioc(_ownedIoc ? *_ownedIoc : *sharedIoContext)
+    , _receiveIoc(_ownedIoc ? std::make_unique<asio::io_context>() : nullptr)
+    , _endpoint(asio::ip::address::from_string(hostIpAddress), tcpPort)
+    , _connectionConfig(connectionConfig)
+    , _socket(_receiveIoc ? *_receiveIoc : _ioc)
+    , _strand(asio::make_strand(_ioc))
+    , _connectTimer(_strand)
+    , _asyncOperationCount(0)
+    , _isAsyncClosed(false)
+    , _reconnectDelay(connectionConfig.reconnectMinDelay)
+    , _isSocketConnected(false)
+    , _isSessionBegun(false)
     , _jsonRpcId(1)
-    , _tcpStreambuf()
-    , _tcpOutStream(&_tcpStreambuf)
+    , _sendMutex()
+    , _isConnected(false)
+    , _connectionCount(0)
+    , _requestedWireEncoding(WireEncoding::JSON)
+    , _outboundBufferPool()
+    , _outboundQueueMutex()
+    , _outboundQueue()
+    , _writtenBuffers()
+    , _writeBuffers()
+    , _jsonWriterMutex()
+    , _jsonOutStreambuf()
+    , _jsonOutStream(&_jsonOutStreambuf)
     , _jsonStreamWriter(nullptr)
-    , _receiveMethodResponseSem(0)
+    , _receiveStreambuf()
+    , _jsonReader(nullptr)
+    , _indexedValueNotificationReceiver(nullptr)
+    , _connectionHandle()
+    , _connectionMutex()
+    , _connectionCv()
     , _isStartReceive(false)
+    , _isBinaryReceive(false)
+    , _isClosing(false)
+    , _receiveThread()
+    , _asyncReceiveEndedPromise()
 {
     Json::StreamWriterBuilder jsonStreamWriterBuilder;
     jsonStreamWriterBuilder["indentation"] = "";
     _jsonStreamWriter.reset(jsonStreamWriterBuilder.newStreamWriter());
+    Json::CharReaderBuilder jsonCharReaderBuilder;
+    _jsonReader.reset(jsonCharReaderBuilder.newCharReader());
 
-    _socket.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string(hostIpAddress), tcpPort));
+    // Start connecting now, the messages are only received after startReceive
+    if (isAsyncReceive())
+        asyncConnect();
+    else
+        _receiveThread = std::thread([](JsonRpcTcpClient * thus){thus->receive();}, this);
 }
 
 JsonRpcTcpClient::~JsonRpcTcpClient()
 {
-    _socket.close();
+    _isClosing = true;
+    if (isAsyncReceive())
+    {
+        // Cancel the pending operations from the strand, and wait for their handlers
+        std::future<void> asyncReceiveEnded = _asyncReceiveEndedPromise.get_future();
+        asio::post(_strand, [this]{
+            _connectTimer.cancel();
+            {
+                std::lock_guard<std::mutex> lk(_sendMutex);
+                _isConnected = false;
+                asio::error_code ec;
+                _socket.close(ec);
+            }
+            _isAsyncClosed = true;
+            if (_asyncOperationCount == 0)
+                _asyncReceiveEndedPromise.set_value();
+        });
+        asyncReceiveEnded.wait();
+        return;
+    }
+
+    // Unblock the receive thread before waiting it, wherever it is waiting
+    {
+        std::lock_guard<std::mutex> lk(_connectionMutex);
+        _connectionCv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lk(_sendMutex);
+        asio::error_code ec;
+        if (_isConnected)
+            _socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+    }
+    _receiveIoc->stop();
+    _receiveThread.join();
+    asio::error_code ec;
+    _socket.close(ec);
 }
 
 void JsonRpcTcpClient::bindNotification(const std::string & methodName, const std::function<void(Json::Value)> & notificationHandle)
@@ -40,10 +154,38 @@ void JsonRpcTcpClient::bindNotification(const std::string & methodName, const st
     _notificationHandles.insert(std::make_pair(methodName, notificationHandle));
 }
 
+void JsonRpcTcpClient::bindIndexedValueNotifications(IndexedValueNotificationReceiver & indexedValueNotificationReceiver)
+{
+    assert(!_isStartReceive);
+    _indexedValueNotificationReceiver = &indexedValueNotificationReceiver;
+}
+
+void JsonRpcTcpClient::bindConnection(const ConnectionHandle & connectionHandle)
+{
+    assert(!_isStartReceive);
+    _connectionHandle = connectionHandle;
+}
+
 void JsonRpcTcpClient::startReceive()
 {
-    _isStartReceive = true;
-    std::thread([](JsonRpcTcpClient * thus){thus->receive();}, this).detach();
+    if (isAsyncReceive())
+    {
+        // The session begins here if the connexion has already been made
+        asio::post(_strand, [this]{
+            _isStartReceive = true;
+            if (_isSocketConnected && !_isSessionBegun && !_isClosing)
+            {
+                beginSession();
+                asyncReceive();
+            }
+        });
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(_connectionMutex);
+        _isStartReceive = true;
+    }
+    _connectionCv.notify_all();
 }
 
 void JsonRpcTcpClient::callNotification(const char * methodName, const Json::Value & params)
@@ -55,107 +197,756 @@ void JsonRpcTcpClient::callNotification(const char * methodName, const Json::Val
     message["params"] = params;
 
     // Send message
-    _jsonStreamWriter->write(message, &_tcpOutStream);
-    _tcpOutStream << static_cast<char>(0x0A);
-    asio::write(_socket, _tcpStreambuf);
+    send(format(message));
+}
 
+void JsonRpcTcpClient::callNotification(const char * methodName, std::initializer_list<NotificationParam> params)
+{
+    OutboundBuffer * buffer = _outboundBufferPool.acquire();
+    buffer->append("{\"jsonrpc\":\"2.0\",\"method\":").appendJson(std::string_view(methodName)).append(",\"params\":{");
+    for (const NotificationParam & param : params)
+    {
+        if (&param != params.begin())
+            buffer->append(',');
+        buffer->appendJson(std::string_view(param.name)).append(':');
+        std::visit([buffer](auto value){buffer->appendJson(value);}, param.value);
+    }
+    buffer->append("}}").append(static_cast<char>(0x0A));
+    send(buffer);
+}
+
+Json::Value JsonRpcTcpClient::callMethod(const char * methodName, const Json::Value & param)
+{
+    auto promise = std::make_shared<std::promise<Json::Value>>();
+    std::future<Json::Value> future = promise->get_future();
+    int jsonRpcId = callMethodAsync(methodName, param, resultHandle(promise));
 #ifdef JSONRPC_DEBUG
-    // Print message
-    std::cout << "send message ";
-    _jsonStreamWriter->write(message, &std::cout);
-    std::cout << std::endl;
+    std::cout << "wait response..." << std::endl;
 #endif
+    if (future.wait_for(_connectionConfig.callTimeout) == std::future_status::timeout)
+    {
+        cancelMethodCalls(jsonRpcId, 1);
+        throw std::runtime_error(std::string("No response to ") + methodName + " before the call timeout");
+    }
+    return future.get();
 }
 
-Json::Value JsonRpcTcpClient::callMethod(const char * methodName, const Json::Value & param)
+std::future<Json::Value> JsonRpcTcpClient::callMethodAsync(const char * methodName, const Json::Value & param)
+{
+    auto promise = std::make_shared<std::promise<Json::Value>>();
+    std::future<Json::Value> future = promise->get_future();
+    callMethodAsync(methodName, param, resultHandle(promise));
+    return future;
+}
+
+int JsonRpcTcpClient::callBatchAsync(const std::vector<BatchCall> & calls, const BatchResponseHandle & batchResponseHandle)
+{
+    if (calls.empty())
+        throw std::invalid_argument("A JSON-RPC batch must contain at least one call");
+
+    int firstJsonRpcId = _jsonRpcId.fetch_add(static_cast<int>(calls.size()));
+
+    // Collect the responses from the receive thread, the server can answer them in any order
+    struct BatchResponses
+    {
+        std::vector<Json::Value> responses;
+        std::size_t remainingCount;
+        BatchResponseHandle batchResponseHandle;
+    };
+    auto batchResponses = std::make_shared<BatchResponses>(
+            BatchResponses{std::vector<Json::Value>(calls.size()), calls.size(), batchResponseHandle});
+
+    // Format the batch, and each call alone to be sent again while it has no response
+    OutboundBuffer * buffer = _outboundBufferPool.acquire();
+    std::vector<std::string> requests(calls.size());
+    {
+        std::lock_guard<std::mutex> lk(_jsonWriterMutex);
+        _jsonOutStreambuf.setBuffer(buffer);
+        buffer->append('[');
+        for (std::size_t i = 0; i < calls.size(); i++)
+        {
+            Json::Value call;
+            call["jsonrpc"] = "2.0";
+            call["method"] = calls[i].methodName;
+            call["params"] = calls[i].params;
+            call["id"] = firstJsonRpcId + static_cast<int>(i);
+            if (i > 0)
+                buffer->append(',');
+            std::size_t callBegin = buffer->size();
+            _jsonStreamWriter->write(call, &_jsonOutStream);
+            requests[i].reserve(buffer->size() - callBegin + 1);
+            requests[i].append(buffer->view().substr(callBegin)).push_back(static_cast<char>(0x0A));
+        }
+        buffer->append(']').append(static_cast<char>(0x0A));
+    }
+#ifdef JSONRPC_DEBUG
+    std::cout << "send message " << buffer->view();
+#endif
+
+    // Registered and queued at once, see connected
+    bool isQueueFull;
+    {
+        std::lock_guard<std::mutex> lk(_pendingMethodsMutex);
+        for (std::size_t i = 0; i < calls.size(); i++)
+        {
+            auto responseHandle = [batchResponses, i](const Json::Value & responseJson){
+                batchResponses->responses[i] = responseJson;
+                if (--batchResponses->remainingCount == 0 && batchResponses->batchResponseHandle)
+                    batchResponses->batchResponseHandle(batchResponses->responses);
+            };
+            _pendingMethods.insert(std::make_pair(firstJsonRpcId + static_cast<int>(i),
+                    PendingMethod{responseHandle, std::move(requests[i]), firstJsonRpcId}));
+        }
+        isQueueFull = enqueue(buffer);
+    }
+    flushOutbound(isQueueFull);
+    return firstJsonRpcId;
+}
+
+std::vector<Json::Value> JsonRpcTcpClient::callBatch(const std::vector<BatchCall> & calls)
 {
+    // Shared with the response handle, which can still run after a timeout
+    auto promise = std::make_shared<std::promise<std::vector<Json::Value>>>();
+    std::future<std::vector<Json::Value>> future = promise->get_future();
+    int firstJsonRpcId = callBatchAsync(calls, [promise](std::vector<Json::Value> & responses){
+        promise->set_value(std::move(responses));});
+    if (future.wait_for(_connectionConfig.callTimeout) == std::future_status::timeout)
+    {
+        cancelMethodCalls(firstJsonRpcId, calls.size());
+        throw std::runtime_error("No response to a batch of " + std::to_string(calls.size()) + " calls before the call timeout");
+    }
+    return future.get();
+}
+
+void JsonRpcTcpClient::cancelMethodCalls(int firstJsonRpcId, std::size_t count)
+{
+    std::lock_guard<std::mutex> lk(_pendingMethodsMutex);
+    auto begin = _pendingMethods.lower_bound(firstJsonRpcId);
+    auto end = _pendingMethods.lower_bound(firstJsonRpcId + static_cast<int>(count));
+    _pendingMethods.erase(begin, end);
+}
+
+WireEncoding JsonRpcTcpClient::negotiateWireEncoding(WireEncoding requestedWireEncoding)
+{
+    _requestedWireEncoding = requestedWireEncoding;
+    auto negotiated = std::make_shared<std::promise<void>>();
+    std::future<void> future = negotiated->get_future();
+    int jsonRpcId = sendWireEncodingRequest(requestedWireEncoding, [negotiated]{negotiated->set_value();});
+    if (future.wait_for(_connectionConfig.callTimeout) == std::future_status::timeout)
+    {
+        cancelMethodCalls(jsonRpcId, 1);
+        throw std::runtime_error(std::string("No response to ") + WIRE_ENCODING_METHOD + " before the call timeout");
+    }
+    return wireEncoding();
+}
+
+int JsonRpcTcpClient::sendWireEncodingRequest(WireEncoding requestedWireEncoding, const std::function<void()> & negotiatedHandle)
+{
+    Json::Value params;
+    params["encoding"] = requestedWireEncoding == WireEncoding::BINARY ? "binary" : "json";
+    // Switch from the receive thread, before reading the next message
+    return callMethodAsync(WIRE_ENCODING_METHOD, params, [this, negotiatedHandle](const Json::Value & responseJson){
+        const Json::Value & result = responseJson["result"];
+        if (result == "binary")
+            _isBinaryReceive = true;
+        else if (result == "json")
+            _isBinaryReceive = false;
+        if (negotiatedHandle)
+            negotiatedHandle();
+    });
+}
+
+asio::awaitable<Json::Value> JsonRpcTcpClient::call(std::string methodName, Json::Value param)
+{
+    auto executor = co_await asio::this_coro::executor;
+    co_return co_await asio::async_initiate<decltype(asio::use_awaitable), void(std::exception_ptr, Json::Value)>(
+            [this, &methodName, &param, executor](auto handler){
+        // The response handle must be copyable, the coroutine handler is only movable
+        auto sharedHandler = std::make_shared<decltype(handler)>(std::move(handler));
+        auto complete = [sharedHandler, executor](std::exception_ptr exceptionPtr, Json::Value result){
+            asio::post(executor, [sharedHandler, exceptionPtr, result]() mutable {
+                (*sharedHandler)(exceptionPtr, std::move(result));});
+        };
+        try
+        {
+            callMethodAsync(methodName.c_str(), param, [complete](const Json::Value & responseJson){
+                if (responseJson.isMember("error"))
+                    complete(std::make_exception_ptr(std::runtime_error(
+                            responseJson["error"]["message"].asString())), Json::Value());
+                else
+                    complete(nullptr, responseJson["result"]);
+            });
+        }
+        catch (...)
+        {
+            complete(std::current_exception(), Json::Value());
+        }
+    }, asio::use_awaitable);
+}
+
+int JsonRpcTcpClient::callMethodAsync(const char * methodName, const Json::Value & param,
+        const MethodResponseHandle & methodResponseHandle)
+{
+    int jsonRpcId = _jsonRpcId++;
+
     // Prepare message
     Json::Value message;
     message["jsonrpc"] = "2.0";
     message["method"] = methodName;
     message["params"] = param;
-    message["id"] = _jsonRpcId;
+    message["id"] = jsonRpcId;
 
-    // Send message
-    _jsonStreamWriter->write(message, &_tcpOutStream);
-    _tcpOutStream << static_cast<char>(0x0A);
-    asio::write(_socket, _tcpStreambuf);
+    OutboundBuffer * buffer = format(message);
+
+    // Register the response handle before sending, the response can arrive before send return.
+    // The request is kept until its response, to be sent again if the connexion is lost meanwhile.
+    // Registered and queued at once, so a new connexion either sends it again or writes it, never both.
+    bool isQueueFull;
+    {
+        std::lock_guard<std::mutex> lk(_pendingMethodsMutex);
+        _pendingMethods.insert(std::make_pair(jsonRpcId, PendingMethod{methodResponseHandle, std::string(buffer->view()), jsonRpcId}));
+        isQueueFull = enqueue(buffer);
+    }
+    flushOutbound(isQueueFull);
+    return jsonRpcId;
+}
+
+OutboundBuffer * JsonRpcTcpClient::format(const Json::Value & message)
+{
+    OutboundBuffer * buffer = _outboundBufferPool.acquire();
+    std::lock_guard<std::mutex> lk(_jsonWriterMutex);
+    _jsonOutStreambuf.setBuffer(buffer);
+    _jsonStreamWriter->write(message, &_jsonOutStream);
+    buffer->append(static_cast<char>(0x0A));
 
 #ifdef JSONRPC_DEBUG
     // Print message
-    std::cout << "send message ";
-    _jsonStreamWriter->write(message, &std::cout);
-    std::cout << std::endl;
+    std::cout << "send message " << buffer->view();
 #endif
+    return buffer;
+}
 
-    // Wait response
-#ifdef JSONRPC_DEBUG
-    std::cout << "wait response..." << std::endl;
-#endif
-    _receiveMethodResponseSem.acquire();
-    Json::Value responseJson = _receiveMethodResponseJsonValue;
-    assert(_jsonRpcId == responseJson["id"].asInt());
-    _receiveMethodResponseJsonValue = Json::Value();
+void JsonRpcTcpClient::send(OutboundBuffer * buffer)
+{
+    // Wait for the writing sender when the queue is full, so the senders cannot outrun the socket
+    flushOutbound(enqueue(buffer));
+}
 
-#ifdef JSONRPC_DEBUG
-    // Print response
-    std::cout << "Receive response ";
-    _jsonStreamWriter->write(responseJson, &std::cout);
-    std::cout << std::endl;
-#endif
+bool JsonRpcTcpClient::enqueue(OutboundBuffer * buffer)
+{
+    std::lock_guard<std::mutex> lk(_outboundQueueMutex);
+    _outboundQueue.push_back(buffer);
+    return _outboundQueue.size() >= MAX_OUTBOUND_QUEUE_SIZE;
+}
 
-    _jsonRpcId++;
-    return responseJson["result"];
+void JsonRpcTcpClient::flushOutbound(bool isWaiting)
+{
+    // The sender owning _sendMutex writes the messages queued by all the senders, the other ones return
+    // at once. The queue is checked again after unlocking, to not leave behind a message queued by a
+    // sender which could not lock.
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lk(_sendMutex, std::defer_lock);
+            if (isWaiting)
+                lk.lock();
+            else if (!lk.try_lock())
+                return;
+            writeOutbound();
+        }
+        isWaiting = false;
+        std::lock_guard<std::mutex> lk(_outboundQueueMutex);
+        if (_outboundQueue.empty())
+            return;
+    }
+}
+
+void JsonRpcTcpClient::writeOutbound()
+{
+    {
+        std::lock_guard<std::mutex> lk(_outboundQueueMutex);
+        _writtenBuffers.swap(_outboundQueue);
+    }
+    if (_writtenBuffers.empty())
+        return;
+
+    // Write all the queued messages with one gather write, or drop them if the connexion is not made
+    if (_isConnected)
+    {
+        _writeBuffers.clear();
+        for (OutboundBuffer * buffer : _writtenBuffers)
+            _writeBuffers.push_back(asio::buffer(buffer->view()));
+        asio::error_code ec;
+        // A span, as asio copies the buffer sequence and a vector copy would allocate
+        asio::write(_socket, std::span<const asio::const_buffer>(_writeBuffers), ec);
+        if (ec)
+        {
+            // Let the receive side see the loss and reconnect
+            _isConnected = false;
+            _socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+        }
+    }
+    for (OutboundBuffer * buffer : _writtenBuffers)
+        _outboundBufferPool.release(buffer);
+    _writtenBuffers.clear();
 }
 
 void JsonRpcTcpClient::receive()
 {
-    asio::streambuf tcpStreambuf;
-    std::istream tcpInStream(&tcpStreambuf);
+    while (!_isClosing)
+    {
+        if (!connect())
+        {
+            std::unique_lock<std::mutex> lk(_connectionMutex);
+            _connectionCv.wait_for(lk, nextReconnectDelay(), [this]{return _isClosing.load();});
+            continue;
+        }
+        {
+            std::unique_lock<std::mutex> lk(_connectionMutex);
+            _connectionCv.wait(lk, [this]{return _isStartReceive || _isClosing;});
+        }
+        if (!_isClosing)
+        {
+            beginSession();
+            receiveConnection();
+        }
+        disconnected();
+    }
+}
 
-    while (true)
+bool JsonRpcTcpClient::connect()
+{
+    // Connect asynchronously to give up at the timeout, the destructor stops the context to give up sooner
+    asio::error_code connectEc = asio::error::would_block;
+    asio::steady_timer timer(*_receiveIoc, _connectionConfig.connectTimeout);
+    _socket.async_connect(_endpoint, [&connectEc, &timer](const asio::error_code & ec){
+        connectEc = ec;
+        timer.cancel();
+    });
+    timer.async_wait([this](const asio::error_code & ec){
+        asio::error_code closeEc;
+        if (!ec)
+            _socket.close(closeEc);
+    });
+    _receiveIoc->restart();
+    if (!_isClosing)
+        _receiveIoc->run();
+    if (connectEc || !connected())
     {
-        // Wait message
-        asio::read_until(_socket, tcpStreambuf, 0x0A);
+        asio::error_code ec;
+        _socket.close(ec);
+        return false;
+    }
+    return true;
+}
+
+void JsonRpcTcpClient::receiveConnection()
+{
+    try
+    {
+        while (true)
+        {
+            // Wait message
 #ifdef JSONRPC_DEBUG
-        std::cout << "wait message..." << std::endl;
+            std::cout << "wait message..." << std::endl;
 #endif
+            asio::error_code ec;
+            bool isBinaryReceive = _isBinaryReceive;
+            std::size_t messageSize = isBinaryReceive ? readFrame(ec)
+                    : asio::read_until(_socket, _receiveStreambuf, static_cast<char>(0x0A), ec);
+            if (ec)
+                return;
+            receiveBufferedMessage(messageSize, isBinaryReceive);
+        }
+    }
+    catch (const std::exception & exception)
+    {
+        // The stream can not be trusted anymore, start again from a new connexion
+        std::cerr << "JSON-RPC receive error, reconnecting: " << exception.what() << std::endl;
+    }
+}
+
+void JsonRpcTcpClient::asyncConnect()
+{
+    _asyncOperationCount += 2;
+    _connectTimer.expires_after(_connectionConfig.connectTimeout);
+    _connectTimer.async_wait(asio::bind_executor(_strand, [this](const asio::error_code & ec){
+        if (isAsyncOperationEnded() || ec || _isConnected)
+            return;
+        // Cancel the connect, its handler reconnects
+        asio::error_code closeEc;
+        _socket.close(closeEc);
+    }));
+    _socket.async_connect(_endpoint, asio::bind_executor(_strand, [this](const asio::error_code & ec){
+        if (isAsyncOperationEnded())
+            return;
+        _connectTimer.cancel();
+        if (ec || !_socket.is_open() || !connected())
+        {
+            asio::error_code closeEc;
+            _socket.close(closeEc);
+            asyncReconnect();
+            return;
+        }
+        if (_isStartReceive)
+        {
+            beginSession();
+            asyncReceive();
+        }
+    }));
+}
 
-        // Extract one json message
-        std::string messageJsonStr;
-        std::getline(tcpInStream, messageJsonStr, static_cast<char>(0x0A));
+void JsonRpcTcpClient::asyncReconnect()
+{
+    _asyncOperationCount++;
+    _connectTimer.expires_after(nextReconnectDelay());
+    _connectTimer.async_wait(asio::bind_executor(_strand, [this](const asio::error_code & ec){
+        if (isAsyncOperationEnded() || ec)
+            return;
+        asyncConnect();
+    }));
+}
 
-        // Parse this json message
-        Json::CharReaderBuilder builder;
-        JSONCPP_STRING errs;
-        Json::Value messageJson;
-        const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-        if (!reader->parse(messageJsonStr.c_str(), messageJsonStr.c_str()+messageJsonStr.size(),
-                &messageJson, &errs))
-            throw std::runtime_error(errs);
+void JsonRpcTcpClient::asyncReceive()
+{
+    bool isBinaryReceive = _isBinaryReceive;
+    auto onRead = [this, isBinaryReceive](const asio::error_code & ec, std::size_t readSize){
+        if (isAsyncOperationEnded())
+            return;
+        try
+        {
+            if (ec)
+            {
+                // Reconnect at once, the backoff only starts from a failed connect
+                disconnected();
+                asyncConnect();
+                return;
+            }
 
-        // If method response
-        if (messageJson.isMember("id"))
+            // A frame can still be incomplete after its header has been read
+            std::size_t messageSize = readSize;
+            if (isBinaryReceive)
+            {
+                std::size_t missingSize;
+                messageSize = bufferedFrameSize(missingSize);
+            }
+            if (messageSize > 0)
+                receiveBufferedMessage(messageSize, isBinaryReceive);
+            // Can throw on the header of the next frame already buffered
+            asyncReceive();
+        }
+        catch (const std::exception & exception)
         {
-            assert(_receiveMethodResponseJsonValue.isNull());
-            _receiveMethodResponseJsonValue = messageJson;
-            _receiveMethodResponseSem.release();
+            // The stream can not be trusted anymore, start again from a new connexion
+            std::cerr << "JSON-RPC receive error, reconnecting: " << exception.what() << std::endl;
+            disconnected();
+            asyncConnect();
         }
-        // If notification
+    };
+
+    if (isBinaryReceive)
+    {
+        // Complete immediately without reading if a whole frame is already buffered
+        std::size_t missingSize;
+        bufferedFrameSize(missingSize);
+        _asyncOperationCount++;
+        asio::async_read(_socket, _receiveStreambuf, asio::transfer_at_least(missingSize), asio::bind_executor(_strand, onRead));
+    }
+    else
+    {
+        _asyncOperationCount++;
+        asio::async_read_until(_socket, _receiveStreambuf, static_cast<char>(0x0A), asio::bind_executor(_strand, onRead));
+    }
+}
+
+bool JsonRpcTcpClient::isAsyncOperationEnded()
+{
+    _asyncOperationCount--;
+    if (!_isClosing)
+        return false;
+    if (_isAsyncClosed && _asyncOperationCount == 0)
+        _asyncReceiveEndedPromise.set_value();
+    return true;
+}
+
+bool JsonRpcTcpClient::connected()
+{
+    {
+        std::lock_guard<std::mutex> lk(_sendMutex);
+        // The destructor only closes a connected socket
+        if (_isClosing)
+            return false;
+        // Drop the messages sent while disconnected, and send again the method calls without response.
+        // The calls are chosen with the new calls blocked from registering, as they are registered and
+        // queued at once: a call registered later is written on this connexion, and not sent again.
+        std::lock_guard<std::mutex> pendingMethodsLock(_pendingMethodsMutex);
+        writeOutbound();
+        enqueuePendingMethods();
+        _isConnected = true;
+    }
+    flushOutbound(false);
+    _isSocketConnected = true;
+    _connectionCount++;
+    _reconnectDelay = _connectionConfig.reconnectMinDelay;
+    return true;
+}
+
+void JsonRpcTcpClient::beginSession()
+{
+    _isSessionBegun = true;
+    if (_connectionHandle)
+        _connectionHandle(true);
+
+    if (_requestedWireEncoding == WireEncoding::BINARY)
+        sendWireEncodingRequest(WireEncoding::BINARY, nullptr);
+}
+
+void JsonRpcTcpClient::enqueuePendingMethods()
+{
+    // In their order, the calls still pending of a batch are sent again as one batch
+    OutboundBuffer * buffer = _outboundBufferPool.acquire();
+    for (auto it = _pendingMethods.begin(); it != _pendingMethods.end();)
+    {
+        int requestFirstId = it->second.requestFirstId;
+        auto requestEnd = std::find_if(it, _pendingMethods.end(), [requestFirstId](const auto & pendingMethod){
+            return pendingMethod.second.requestFirstId != requestFirstId;});
+        if (std::next(it) == requestEnd)
+            buffer->append(it->second.request);
         else
         {
-#ifdef JSONRPC_DEBUG
-            // Print notification
-            std::cout << "Receive notification ";
-            _jsonStreamWriter->write(messageJson, &std::cout);
-            std::cout << std::endl;
-#endif
-            // Find the notification and execute it
-            auto it = _notificationHandles.find(messageJson["method"].asString());
+            buffer->append('[');
+            for (auto call = it; call != requestEnd; ++call)
+            {
+                if (call != it)
+                    buffer->append(',');
+                // Without its line feed
+                const std::string & request = call->second.request;
+                buffer->append(std::string_view(request).substr(0, request.size() - 1));
+            }
+            buffer->append(']').append(static_cast<char>(0x0A));
+        }
+        it = requestEnd;
+    }
+    if (buffer->size() > 0)
+        enqueue(buffer);
+    else
+        _outboundBufferPool.release(buffer);
+}
+
+void JsonRpcTcpClient::disconnected()
+{
+    {
+        std::lock_guard<std::mutex> lk(_sendMutex);
+        _isConnected = false;
+        asio::error_code ec;
+        _socket.close(ec);
+    }
+    // Drop the messages queued meanwhile
+    flushOutbound(false);
+    _isSocketConnected = false;
+    // A new connexion starts with an empty stream in JSON
+    _receiveStreambuf.consume(_receiveStreambuf.size());
+    _isBinaryReceive = false;
+    if (_isSessionBegun && _connectionHandle && !_isClosing)
+        _connectionHandle(false);
+    _isSessionBegun = false;
+}
+
+std::chrono::milliseconds JsonRpcTcpClient::nextReconnectDelay()
+{
+    std::chrono::milliseconds reconnectDelay = _reconnectDelay;
+    _reconnectDelay = std::min(_reconnectDelay*2, _connectionConfig.reconnectMaxDelay);
+    return reconnectDelay;
+}
+
+std::size_t JsonRpcTcpClient::readFrame(asio::error_code & ec)
+{
+    std::size_t missingSize;
+    std::size_t frameSize;
+    while ((frameSize = bufferedFrameSize(missingSize)) == 0)
+    {
+        asio::read(_socket, _receiveStreambuf, asio::transfer_at_least(missingSize), ec);
+        if (ec)
+            return 0;
+    }
+    return frameSize;
+}
+
+std::size_t JsonRpcTcpClient::bufferedFrameSize(std::size_t & missingSize) const
+{
+    return wireFrameSize(static_cast<const char *>(_receiveStreambuf.data().data()), _receiveStreambuf.size(), missingSize);
+}
+
+void JsonRpcTcpClient::receiveBufferedMessage(std::size_t messageSize, bool isBinaryReceive)
+{
+    // Parse the message in place from the receive buffer (without the end of line of a json message)
+    const char * messageBegin = static_cast<const char *>(_receiveStreambuf.data().data());
+    if (isBinaryReceive)
+        receiveFrame(messageBegin, messageSize, std::chrono::steady_clock::now());
+    else
+        receiveMessage(messageBegin, messageBegin + messageSize - 1, std::chrono::steady_clock::now());
+    _receiveStreambuf.consume(messageSize);
+}
+
+void JsonRpcTcpClient::receiveFrame(const char * frame, std::size_t frameSize, std::chrono::steady_clock::time_point receiveTime)
+{
+    const char * payload = frame + WIRE_FRAME_HEADER_SIZE;
+    std::size_t payloadSize = frameSize - WIRE_FRAME_HEADER_SIZE;
+    switch (wireFrameType(frame))
+    {
+        case WireFrameType::JSON:
+            receiveMessage(payload, payload + payloadSize, receiveTime);
+            return;
+        case WireFrameType::INDEXED_VALUE:
+        {
+            IndexedValueNotification indexedValueNotification;
+            if (!decodeWireIndexedValue(payload, payloadSize, indexedValueNotification))
+                throw std::runtime_error("Invalid indexed value frame");
+            indexedValueNotification.receiveTime = receiveTime;
+            indexedValueNotification.parseTime = std::chrono::steady_clock::now();
+            if (_indexedValueNotificationReceiver)
+            {
+                _indexedValueNotificationReceiver->receiveIndexedValueNotification(indexedValueNotification);
+                return;
+            }
+
+            // Fallback to the generic handle, boolean values are given as 0 or 1
+            auto it = _notificationHandles.find(indexedValueMethodName(indexedValueNotification.method));
             if (it != _notificationHandles.end())
             {
-                it->second(messageJson["params"]);
+                Json::Value params;
+                params["index"] = static_cast<Json::UInt64>(indexedValueNotification.index);
+                params["value"] = static_cast<Json::Int64>(indexedValueNotification.value);
+                params["changedCount"] = indexedValueNotification.changedCount;
+                it->second(params);
             }
+            return;
+        }
+    }
+    throw std::runtime_error(std::string("Unknown frame type ") + std::to_string(static_cast<int>(wireFrameType(frame))));
+}
+
+void JsonRpcTcpClient::receiveMessage(const char * begin, const char * end, std::chrono::steady_clock::time_point receiveTime)
+{
+    // Fast path for sensor notifications
+    IndexedValueNotification indexedValueNotification;
+    indexedValueNotification.receiveTime = receiveTime;
+    if (_indexedValueNotificationReceiver && parseIndexedValueNotification(begin, end, indexedValueNotification))
+    {
+        indexedValueNotification.parseTime = std::chrono::steady_clock::now();
+#ifdef JSONRPC_DEBUG
+        // Print notification
+        std::cout << "Receive notification " << std::string_view(begin, end - begin) << std::endl;
+#endif
+        _indexedValueNotificationReceiver->receiveIndexedValueNotification(indexedValueNotification);
+        return;
+    }
+
+    // Parse this json message
+    JSONCPP_STRING errs;
+    if (!_jsonReader->parse(begin, end, &_receiveMessageJson, &errs))
+        throw std::runtime_error(errs);
+    const Json::Value & messageJson = _receiveMessageJson;
+
+    // If batch response
+    if (messageJson.isArray())
+    {
+        for (const Json::Value & responseJson : messageJson)
+            receiveResponse(responseJson);
+    }
+    // If method response
+    else if (messageJson.isMember("id"))
+        receiveResponse(messageJson);
+    // If notification
+    else
+    {
+#ifdef JSONRPC_DEBUG
+        // Print notification
+        std::cout << "Receive notification ";
+        _jsonStreamWriter->write(messageJson, &std::cout);
+        std::cout << std::endl;
+#endif
+        const char * methodName = nullptr;
+        const char * methodNameEnd = nullptr;
+        const Json::Value & params = messageJson["params"];
+        if (!messageJson["method"].getString(&methodName, &methodNameEnd))
+            return;
+        std::string_view method(methodName, methodNameEnd - methodName);
+
+        // Sensor notification not matching the fast path shape
+        auto indexedValueMethodFound = indexedValueMethod(method);
+        if (_indexedValueNotificationReceiver && indexedValueMethodFound.has_value())
+        {
+            const Json::Value & value = params["value"];
+            indexedValueNotification.method = indexedValueMethodFound.value();
+            indexedValueNotification.index = params["index"].asUInt();
+            indexedValueNotification.value = value.isBool() ? value.asBool() : value.asInt64();
+            indexedValueNotification.changedCount = params["changedCount"].asInt();
+            indexedValueNotification.parseTime = std::chrono::steady_clock::now();
+            _indexedValueNotificationReceiver->receiveIndexedValueNotification(indexedValueNotification);
+            return;
         }
+
+        // Find the notification and execute it
+        auto it = _notificationHandles.find(method);
+        if (it != _notificationHandles.end())
+            it->second(params);
+    }
+}
+
+void JsonRpcTcpClient::receiveResponse(const Json::Value & responseJson)
+{
+#ifdef JSONRPC_DEBUG
+    // Print response
+    std::cout << "Receive response ";
+    _jsonStreamWriter->write(responseJson, &std::cout);
+    std::cout << std::endl;
+#endif
+    const Json::Value & id = responseJson["id"];
+    if (!id.isInt())
+    {
+        // The server could not read the request, or rejected the whole batch
+        if (id.isNull() && responseJson.isMember("error"))
+            failOldestRequest(responseJson);
+        return;
+    }
+
+    // Find the pending method call with the same id and give it the response
+    MethodResponseHandle methodResponseHandle;
+    {
+        std::lock_guard<std::mutex> lk(_pendingMethodsMutex);
+        auto it = _pendingMethods.find(id.asInt());
+        if (it != _pendingMethods.end())
+        {
+            methodResponseHandle = std::move(it->second.methodResponseHandle);
+            _pendingMethods.erase(it);
+        }
+    }
+    if (methodResponseHandle)
+        methodResponseHandle(responseJson);
+}
+
+void JsonRpcTcpClient::failOldestRequest(const Json::Value & errorResponseJson)
+{
+    // The server answers the requests in their order, so the error without id is for the oldest one
+    std::vector<std::pair<int, MethodResponseHandle>> failedMethods;
+    {
+        std::lock_guard<std::mutex> lk(_pendingMethodsMutex);
+        if (_pendingMethods.empty())
+            return;
+        int requestFirstId = _pendingMethods.begin()->second.requestFirstId;
+        auto it = _pendingMethods.begin();
+        while (it != _pendingMethods.end() && it->second.requestFirstId == requestFirstId)
+        {
+            failedMethods.emplace_back(it->first, std::move(it->second.methodResponseHandle));
+            it = _pendingMethods.erase(it);
+        }
+    }
+    for (auto & failedMethod : failedMethods)
+    {
+        Json::Value responseJson = errorResponseJson;
+        responseJson["id"] = failedMethod.first;
+        if (failedMethod.second)
+            failedMethod.second(responseJson);
     }
 }
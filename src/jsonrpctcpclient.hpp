@@ -4,46 +4,270 @@
 #include <asio/ip/tcp.hpp>
 #include <asio/streambuf.hpp>
 #include <asio/io_context.hpp>
-#include <semaphore>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <initializer_list>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
 #include <json/value.h>
+#include "indexedvaluenotification.hpp"
+#include "outboundbuffer.hpp"
+#include "wireprotocol.hpp"
 
 namespace Json
 {
     class StreamWriter;
+    class CharReader;
 }
 
 
+//! @brief JSON-RPC client of a robot server.
+//! The connexion is made in background, without blocking the constructor, and made again at once
+//! each time it is lost, then with an exponential backoff while it cannot be made before a timeout.
+//! The method calls without response are sent again on the new connexion, the notifications sent
+//! while disconnected are dropped.
 class JsonRpcTcpClient
 {
 public:
+    struct ConnectionConfig
+    {
+        std::chrono::milliseconds connectTimeout = std::chrono::milliseconds(1000);
+        std::chrono::milliseconds reconnectMinDelay = std::chrono::milliseconds(20); //!< Delay after the first failed connect
+        std::chrono::milliseconds reconnectMaxDelay = std::chrono::milliseconds(500); //!< Doubled up to it at each failure
+        //! Maximum wait of the blocking calls (callMethod, callBatch, negotiateWireEncoding)
+        std::chrono::milliseconds callTimeout = std::chrono::milliseconds(5000);
+    };
+
+    //! @brief Connect with a dedicated receive thread.
     JsonRpcTcpClient(const std::string & hostIpAddress, unsigned short tcpPort);
+    JsonRpcTcpClient(const std::string & hostIpAddress, unsigned short tcpPort, const ConnectionConfig & connectionConfig);
+
+    //! @brief Connect with asynchronous reads on a shared context instead of a dedicated thread.
+    //! The handles are called from the threads running ioContext, one at a time for this client.
+    //! @warning ioContext must be run until this client is destroyed, from other threads than the
+    //! one destroying it.
+    JsonRpcTcpClient(asio::io_context & ioContext, const std::string & hostIpAddress, unsigned short tcpPort);
+    JsonRpcTcpClient(asio::io_context & ioContext, const std::string & hostIpAddress, unsigned short tcpPort,
+            const ConnectionConfig & connectionConfig);
+
     ~JsonRpcTcpClient();
 
     using NotificationHandle = std::function<void(Json::Value)>;
     void bindNotification(const std::string & methodName, const NotificationHandle & notificationHandle);
 
+    //! @brief Bind all the sensor notifications of IndexedValueMethod, with the fixed shape params
+    //! {index, value, changedCount}.
+    //! They are dispatched by method id, without any lookup by name, and decoded without building any
+    //! Json::Value when possible (fallback to the generic json parser otherwise).
+    //! The other methods still use the handles of bindNotification.
+    void bindIndexedValueNotifications(IndexedValueNotificationReceiver & indexedValueNotificationReceiver);
+
+    //! @brief Be told when a connexion starts to be received and when it is lost.
+    //! @param connectionHandle Called from the receive thread with true before the first message of
+    //! each connexion, and with false after the last one.
+    using ConnectionHandle = std::function<void(bool isConnected)>;
+    void bindConnection(const ConnectionHandle & connectionHandle);
+
     //! @warning start receive only after bind all notification
     void startReceive();
 
+    //! @return True if the connexion is currently made.
+    bool isConnected() const {return _isConnected;}
+
+    //! @return The number of connexions made again after a loss.
+    std::uint64_t reconnectCount() const
+    {
+        std::uint64_t connectionCount = _connectionCount;
+        return connectionCount > 0 ? connectionCount - 1 : 0;
+    }
+
+    //! @brief Send a notification, dropped if the connexion is not made.
     void callNotification(const char * methodName, const Json::Value & param);
+
+    //! @brief Member of the params object of a fixed-shape notification.
+    struct NotificationParam
+    {
+        const char * name;
+        std::variant<float, double, std::int64_t, std::string_view> value;
+    };
+
+    //! @brief Send a notification formatted straight into a pooled buffer, without Json::Value nor
+    //! allocation in the steady state.
+    void callNotification(const char * methodName, std::initializer_list<NotificationParam> params);
+
+    //! @return The number of outbound buffers allocated, it stops growing once the outbound queue is full
+    //! and every concurrent sender has one.
+    std::size_t outboundBufferCount() const {return _outboundBufferPool.size();}
+
+    //! @brief Send a method call and block until its response has been received.
+    //! @return The "result" member of the response.
+    //! @throw std::runtime_error If the response contains an "error" member, or if it has not been
+    //! received before the call timeout (the call is then cancelled).
     Json::Value callMethod(const char * methodName, const Json::Value & param);
 
+    //! @brief Send a method call without waiting its response.
+    //! Many calls can be in flight at the same time, responses are matched by JSON-RPC id.
+    //! @return A future set with the "result" member of the response, or with an exception if the
+    //! response contains an "error" member.
+    std::future<Json::Value> callMethodAsync(const char * methodName, const Json::Value & param);
+
+    //! @brief Send a method call without waiting its response.
+    //! @param methodResponseHandle Called from the receive thread with the whole response message.
+    //! @return The JSON-RPC id of the call.
+    using MethodResponseHandle = std::function<void(const Json::Value &)>;
+    int callMethodAsync(const char * methodName, const Json::Value & param,
+            const MethodResponseHandle & methodResponseHandle);
+
+    //! @brief One method call of a batch.
+    struct BatchCall
+    {
+        std::string methodName;
+        Json::Value params;
+    };
+
+    //! @brief Send many method calls in one write, as one JSON-RPC batch answered by one array of
+    //! responses, without waiting the responses.
+    //! @param batchResponseHandle Called from the receive thread with the whole response of each call,
+    //! in the order of calls. A failed call has an "error" member, it does not fail the other ones. An
+    //! error without id (the server rejected the whole batch) fails all the calls still pending.
+    //! @return The JSON-RPC id of the first call, the next calls have the next ids.
+    //! @throw std::invalid_argument If calls is empty.
+    using BatchResponseHandle = std::function<void(std::vector<Json::Value> & responses)>;
+    int callBatchAsync(const std::vector<BatchCall> & calls, const BatchResponseHandle & batchResponseHandle);
+
+    //! @brief Send a batch of method calls and block until all their responses have been received.
+    //! @return The whole response of each call, in the order of calls.
+    //! @throw std::runtime_error If the responses have not been received before the call timeout (the
+    //! calls are then cancelled).
+    std::vector<Json::Value> callBatch(const std::vector<BatchCall> & calls);
+
+    //! @brief Forget the calls of these ids still without response: they are not sent again, and their
+    //! response handles are not called anymore.
+    void cancelMethodCalls(int firstJsonRpcId, std::size_t count);
+
+    std::chrono::milliseconds callTimeout() const {return _connectionConfig.callTimeout;}
+
+    //! @brief Ask the server to send its next messages with this encoding, and wait its answer.
+    //! A server which does not support it answers an error and keeps the current encoding.
+    //! @warning Must be called after startReceive.
+    //! @return The encoding used by the server from now.
+    //! @throw std::runtime_error If the server has not answered before the call timeout.
+    WireEncoding negotiateWireEncoding(WireEncoding requestedWireEncoding);
+
+    //! @return The encoding of the messages received from the server.
+    WireEncoding wireEncoding() const {return _isBinaryReceive ? WireEncoding::BINARY : WireEncoding::JSON;}
+
+    //! @brief Send a method call from a coroutine, without blocking its thread.
+    //! The coroutine is resumed on its own executor when the response has been received.
+    //! @return The "result" member of the response.
+    //! @throw std::runtime_error If the response contains an "error" member.
+    asio::awaitable<Json::Value> call(std::string methodName, Json::Value param);
+
+    //! @brief Context on which coroutines using this client can run, it is only run by the client
+    //! owner.
+    asio::io_context & ioContext() {return _ioc;}
+
+    //! @return True if this client receives with asynchronous reads on a shared context.
+    bool isAsyncReceive() const {return !_ownedIoc;}
+
 private:
     JsonRpcTcpClient(const JsonRpcTcpClient &) = delete;
     JsonRpcTcpClient & operator=(const JsonRpcTcpClient &) = delete;
 
+    JsonRpcTcpClient(std::unique_ptr<asio::io_context> ownedIoContext, asio::io_context * sharedIoContext,
+            const std::string & hostIpAddress, unsigned short tcpPort, const ConnectionConfig & connectionConfig);
+
+    //! Messages queued before a sender waits for the writing one
+    static constexpr std::size_t MAX_OUTBOUND_QUEUE_SIZE = 64;
+
+    struct PendingMethod
+    {
+        MethodResponseHandle methodResponseHandle;
+        std::string request; //!< Message of this call alone, to be sent again on a new connexion
+        int requestFirstId; //!< First id of the batch of this call, its own id if not in a batch
+    };
+
     void receive();
+    bool connect();
+    void receiveConnection();
+    void asyncConnect();
+    void asyncReconnect();
+    void asyncReceive();
+    bool isAsyncOperationEnded();
+    //! @brief Mark the socket connected, after queuing the method calls to send again.
+    bool connected();
+    void beginSession();
+    //! @warning Must be called with _sendMutex and _pendingMethodsMutex.
+    void enqueuePendingMethods();
+    void disconnected();
+    std::chrono::milliseconds nextReconnectDelay();
+    int sendWireEncodingRequest(WireEncoding requestedWireEncoding, const std::function<void()> & negotiatedHandle);
+    std::size_t readFrame(asio::error_code & ec);
+    std::size_t bufferedFrameSize(std::size_t & missingSize) const;
+    void receiveBufferedMessage(std::size_t messageSize, bool isBinaryReceive);
+    void receiveFrame(const char * frame, std::size_t frameSize, std::chrono::steady_clock::time_point receiveTime);
+    void receiveMessage(const char * begin, const char * end, std::chrono::steady_clock::time_point receiveTime);
+    void receiveResponse(const Json::Value & responseJson);
+    OutboundBuffer * format(const Json::Value & message);
+    void failOldestRequest(const Json::Value & errorResponseJson);
+    void send(OutboundBuffer * buffer);
+    //! @return True if the queue is full, the sender must then wait for the writing one.
+    bool enqueue(OutboundBuffer * buffer);
+    void flushOutbound(bool isWaiting);
+    void writeOutbound();
 
-    asio::io_context _ioc;
+    std::unique_ptr<asio::io_context> _ownedIoc; //!< Null when the context is shared
+    asio::io_context & _ioc;
+    std::unique_ptr<asio::io_context> _receiveIoc; //!< Only run by the receive thread to connect, null when the context is shared
+    asio::ip::tcp::endpoint _endpoint;
+    ConnectionConfig _connectionConfig;
     asio::ip::tcp::socket _socket;
-    int _jsonRpcId;
-    asio::streambuf _tcpStreambuf;
-    std::ostream _tcpOutStream;
+    asio::strand<asio::io_context::executor_type> _strand; //!< Serialize the asynchronous operations
+    asio::steady_timer _connectTimer; //!< Connect timeout then reconnect delay, only used from _strand
+    std::size_t _asyncOperationCount; //!< Pending asynchronous operations, only used from _strand
+    bool _isAsyncClosed; //!< Only used from _strand
+    std::chrono::milliseconds _reconnectDelay; //!< Only used by the receive thread or _strand
+    bool _isSocketConnected; //!< True from a connect success to the disconnexion, only used by the receive thread or _strand
+    bool _isSessionBegun; //!< Only used by the receive thread or _strand
+    std::atomic<int> _jsonRpcId;
+    std::mutex _sendMutex; //!< Owned by the sender writing, also protect the socket state against the writes
+    std::atomic<bool> _isConnected; //!< Only changed with _sendMutex
+    std::atomic<std::uint64_t> _connectionCount;
+    std::atomic<WireEncoding> _requestedWireEncoding; //!< Negotiated again on each new connexion
+    OutboundBufferPool _outboundBufferPool;
+    std::mutex _outboundQueueMutex;
+    std::vector<OutboundBuffer *> _outboundQueue; //!< Formatted messages waiting to be written, in send order
+    std::vector<OutboundBuffer *> _writtenBuffers; //!< Only used with _sendMutex
+    std::vector<asio::const_buffer> _writeBuffers; //!< Only used with _sendMutex
+    std::mutex _jsonWriterMutex; //!< Protect the serialization of the Json::Value messages
+    OutboundStreambuf _jsonOutStreambuf;
+    std::ostream _jsonOutStream;
     std::unique_ptr<Json::StreamWriter> _jsonStreamWriter;
-    std::binary_semaphore _receiveMethodResponseSem;
-    Json::Value _receiveMethodResponseJsonValue;
-    std::map<std::string, NotificationHandle> _notificationHandles;
-    bool _isStartReceive;
+    std::mutex _pendingMethodsMutex;
+    std::map<int, PendingMethod> _pendingMethods;
+    asio::streambuf _receiveStreambuf;
+    std::unique_ptr<Json::CharReader> _jsonReader;
+    Json::Value _receiveMessageJson;
+    std::map<std::string, NotificationHandle, std::less<>> _notificationHandles;
+    IndexedValueNotificationReceiver * _indexedValueNotificationReceiver;
+    ConnectionHandle _connectionHandle;
+    std::mutex _connectionMutex; //!< Wake up the receive thread waiting to start or to reconnect
+    std::condition_variable _connectionCv;
+    std::atomic<bool> _isStartReceive;
+    std::atomic<bool> _isBinaryReceive; //!< Only changed by the receive thread or asynchronous reads
+    std::atomic<bool> _isClosing;
+    std::thread _receiveThread;
+    std::promise<void> _asyncReceiveEndedPromise; //!< Set when no more asynchronous operation is pending
 };
 
 #endif
\ No newline at end of file
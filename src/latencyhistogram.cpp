@@ -0,0 +1,65 @@
+#include "latencyhistogram.hpp"
+
+#include <algorithm>
+#include <bit>
+
+
+LatencyHistogram::LatencyHistogram()
+    : _buckets()
+    , _count(0)
+    , _max(0)
+{
+    reset();
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency)
+{
+    std::uint64_t value = static_cast<std::uint64_t>(std::max<std::int64_t>(latency.count(), 0));
+    _buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t currentMax = _max.load(std::memory_order_relaxed);
+    while (value > currentMax && !_max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed));
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto & bucket : _buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double ratio) const
+{
+    std::uint64_t totalCount = _count.load(std::memory_order_relaxed);
+    if (totalCount == 0)
+        return std::chrono::nanoseconds(0);
+    std::uint64_t rank = static_cast<std::uint64_t>(std::clamp(ratio, 0.0, 1.0)*static_cast<double>(totalCount - 1)) + 1;
+    std::uint64_t cumulated = 0;
+    for (std::size_t index = 0; index < BUCKET_COUNT; index++)
+    {
+        cumulated += _buckets[index].load(std::memory_order_relaxed);
+        if (cumulated >= rank)
+            return std::chrono::nanoseconds(std::min(bucketUpperBound(index), _max.load(std::memory_order_relaxed)));
+    }
+    return max();
+}
+
+std::size_t LatencyHistogram::bucketIndex(std::uint64_t value)
+{
+    value = std::min(value, (std::uint64_t(1) << (MAX_EXPONENT + 1)) - 1);
+    if (value < SUB_BUCKET_COUNT)
+        return static_cast<std::size_t>(value);
+    unsigned exponent = std::bit_width(value) - 1;
+    std::uint64_t subBucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return static_cast<std::size_t>((exponent - SUB_BUCKET_BITS + 1)*SUB_BUCKET_COUNT + subBucket);
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t index)
+{
+    if (index < SUB_BUCKET_COUNT)
+        return index;
+    unsigned shift = static_cast<unsigned>(index/SUB_BUCKET_COUNT - 1);
+    std::uint64_t lowerBound = (SUB_BUCKET_COUNT + index%SUB_BUCKET_COUNT) << shift;
+    return lowerBound + (std::uint64_t(1) << shift) - 1;
+}
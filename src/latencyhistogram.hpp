@@ -0,0 +1,44 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+
+//! @brief Lock-free log-linear latency histogram (like HDR histogram, with 3 significant bits).
+//! Each power of two is split in 8 buckets, so a percentile is known within 12.5%.
+//! record can be called from any thread without blocking readers.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(std::chrono::nanoseconds latency);
+    void reset();
+
+    std::uint64_t count() const {return _count.load(std::memory_order_relaxed);}
+    std::chrono::nanoseconds max() const {return std::chrono::nanoseconds(_max.load(std::memory_order_relaxed));}
+
+    //! @return The upper bound of the bucket containing this ratio (between 0.0 and 1.0) of the latencies.
+    std::chrono::nanoseconds percentile(double ratio) const;
+
+private:
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram & operator=(const LatencyHistogram &) = delete;
+
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr std::uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static constexpr unsigned MAX_EXPONENT = 40; //!< About 18 minutes
+    static constexpr std::size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2)*SUB_BUCKET_COUNT;
+
+    static std::size_t bucketIndex(std::uint64_t value);
+    static std::uint64_t bucketUpperBound(std::size_t index);
+
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> _buckets;
+    std::atomic<std::uint64_t> _count;
+    std::atomic<std::uint64_t> _max;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "linetracker.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+namespace
+{
+#if defined(__GNUC__)
+    //! 4 floats with the vector extensions of gcc and clang, mapped to SSE on x86-64 and NEON on AArch64
+    typedef float Float4 __attribute__((vector_size(16)));
+
+    inline Float4 minFloat4(Float4 a, Float4 b)
+    {
+        return a < b ? a : b;
+    }
+
+    inline Float4 maxFloat4(Float4 a, Float4 b)
+    {
+        return a > b ? a : b;
+    }
+#else
+    //! 4 floats computed lane by lane, left to the auto-vectorizer of the other compilers
+    struct Float4
+    {
+        float lanes[4];
+
+        float operator[](std::size_t lane) const {return lanes[lane];}
+
+        Float4 & operator+=(const Float4 & other)
+        {
+            for (std::size_t lane = 0; lane < 4; lane++)
+                lanes[lane] += other.lanes[lane];
+            return *this;
+        }
+    };
+
+    inline Float4 operator-(const Float4 & a, const Float4 & b)
+    {
+        return {{a.lanes[0] - b.lanes[0], a.lanes[1] - b.lanes[1], a.lanes[2] - b.lanes[2], a.lanes[3] - b.lanes[3]}};
+    }
+
+    inline Float4 operator*(const Float4 & a, const Float4 & b)
+    {
+        return {{a.lanes[0]*b.lanes[0], a.lanes[1]*b.lanes[1], a.lanes[2]*b.lanes[2], a.lanes[3]*b.lanes[3]}};
+    }
+
+    inline Float4 minFloat4(const Float4 & a, const Float4 & b)
+    {
+        return {{std::min(a.lanes[0], b.lanes[0]), std::min(a.lanes[1], b.lanes[1]),
+                std::min(a.lanes[2], b.lanes[2]), std::min(a.lanes[3], b.lanes[3])}};
+    }
+
+    inline Float4 maxFloat4(const Float4 & a, const Float4 & b)
+    {
+        return {{std::max(a.lanes[0], b.lanes[0]), std::max(a.lanes[1], b.lanes[1]),
+                std::max(a.lanes[2], b.lanes[2]), std::max(a.lanes[3], b.lanes[3])}};
+    }
+#endif
+    constexpr std::size_t LANE_COUNT = sizeof(Float4)/sizeof(float);
+    static_assert(LANE_COUNT == 4);
+    static_assert(LineTracker::CAPACITY%LANE_COUNT == 0);
+
+    inline Float4 loadFloat4(const float * data)
+    {
+        Float4 vector;
+        std::memcpy(&vector, data, sizeof(vector));
+        return vector;
+    }
+
+    inline void storeFloat4(float * data, Float4 vector)
+    {
+        std::memcpy(data, &vector, sizeof(vector));
+    }
+
+    inline float sumLanes(Float4 vector)
+    {
+        return (vector[0] + vector[1]) + (vector[2] + vector[3]);
+    }
+
+    inline float maxLanes(Float4 vector)
+    {
+        return std::max(std::max(vector[0], vector[1]), std::max(vector[2], vector[3]));
+    }
+}
+
+LineTracker::LineTracker(const Config & config)
+    : _mutex()
+    , _config()
+    , _sensorCount(0)
+    , _isCalibrating(false)
+    , _floorValues()
+    , _lineValues()
+    , _calibrationMins()
+    , _calibrationMaxs()
+    , _rawValues()
+    , _offsets()
+    , _scales()
+    , _positions()
+    , _readings()
+    , _estimate()
+    , _seqLock()
+    , _publishedReadings()
+    , _position(0.0)
+    , _confidence(0.0)
+    , _time(0)
+    , _updateCount(0)
+{
+    _lineValues.fill(255);
+    setConfig(config);
+}
+
+void LineTracker::setConfig(const Config & config)
+{
+    if (config.sensorCount > CAPACITY)
+        throw std::invalid_argument(std::string("Line tracker sensor count ") + std::to_string(config.sensorCount)
+                + " out of capacity " + std::to_string(CAPACITY));
+    std::lock_guard<std::mutex> lk(_mutex);
+    bool isLineDarkChanged = config.isLineDark != _config.isLineDark;
+    _config = config;
+    if (isLineDarkChanged)
+    {
+        _floorValues.fill(_config.isLineDark ? 255 : 0);
+        _lineValues.fill(_config.isLineDark ? 0 : 255);
+    }
+    if (_config.sensorCount != 0)
+        _sensorCount = _config.sensorCount;
+    updatePositions();
+}
+
+void LineTracker::setCalibration(std::size_t index, std::uint8_t floorValue, std::uint8_t lineValue)
+{
+    if (index >= CAPACITY)
+        throw std::out_of_range(std::string("Line tracker index ") + std::to_string(index)
+                + " out of capacity " + std::to_string(CAPACITY));
+    std::lock_guard<std::mutex> lk(_mutex);
+    _floorValues[index] = floorValue;
+    _lineValues[index] = lineValue;
+    updateCalibration(index);
+}
+
+void LineTracker::startCalibration()
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    _isCalibrating = true;
+    _calibrationMins.fill(255);
+    _calibrationMaxs.fill(0);
+}
+
+void LineTracker::stopCalibration()
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    _isCalibrating = false;
+}
+
+bool LineTracker::update(std::size_t index, std::uint8_t rawValue, std::chrono::steady_clock::time_point time)
+{
+    if (index >= CAPACITY)
+        return false;
+    std::lock_guard<std::mutex> lk(_mutex);
+    if (index >= _sensorCount && _config.sensorCount == 0)
+    {
+        _sensorCount = index + 1;
+        updatePositions();
+    }
+    _rawValues[index] = rawValue;
+    if (_isCalibrating)
+    {
+        _calibrationMins[index] = std::min(_calibrationMins[index], rawValue);
+        _calibrationMaxs[index] = std::max(_calibrationMaxs[index], rawValue);
+        _floorValues[index] = _config.isLineDark ? _calibrationMaxs[index] : _calibrationMins[index];
+        _lineValues[index] = _config.isLineDark ? _calibrationMins[index] : _calibrationMaxs[index];
+        updateCalibration(index);
+    }
+
+    // Calibrate all the readings and accumulate the centroid sums, LANE_COUNT sensors at a time
+    const Float4 zero = {0.0f, 0.0f, 0.0f, 0.0f};
+    const Float4 one = {1.0f, 1.0f, 1.0f, 1.0f};
+    const Float4 noiseFloor = {_config.noiseFloor, _config.noiseFloor, _config.noiseFloor, _config.noiseFloor};
+    Float4 weightSum = zero;
+    Float4 weightedPositionSum = zero;
+    Float4 readingMax = zero;
+    for (std::size_t i = 0; i < CAPACITY; i += LANE_COUNT)
+    {
+        Float4 reading = (loadFloat4(&_rawValues[i]) - loadFloat4(&_offsets[i]))*loadFloat4(&_scales[i]);
+        reading = minFloat4(maxFloat4(reading, zero), one);
+        storeFloat4(&_readings[i], reading);
+        Float4 weight = reading - noiseFloor;
+        weight = maxFloat4(weight, zero);
+        weightSum += weight;
+        weightedPositionSum += weight*loadFloat4(&_positions[i]);
+        readingMax = maxFloat4(reading, readingMax);
+    }
+
+    float totalWeight = sumLanes(weightSum);
+    if (totalWeight > 0.0f)
+    {
+        // Keep the last position when the line is lost, to know on which side it has been lost
+        _estimate.position = sumLanes(weightedPositionSum)/totalWeight;
+        _estimate.confidence = maxLanes(readingMax);
+    }
+    else
+        _estimate.confidence = 0.0;
+    _estimate.time = time;
+    _estimate.updateCount++;
+    publish();
+    return true;
+}
+
+LineTracker::Estimate LineTracker::estimate() const
+{
+    Estimate estimate;
+    _seqLock.read([this, &estimate]{
+        estimate.position = _position.load(std::memory_order_relaxed);
+        estimate.confidence = _confidence.load(std::memory_order_relaxed);
+        estimate.time = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(_time.load(std::memory_order_relaxed)));
+        estimate.updateCount = _updateCount.load(std::memory_order_relaxed);
+    });
+    return estimate;
+}
+
+float LineTracker::reading(std::size_t index) const
+{
+    if (index >= CAPACITY)
+        return 0.0f;
+    return _publishedReadings[index].load(std::memory_order_relaxed);
+}
+
+void LineTracker::updatePositions()
+{
+    double center = (static_cast<double>(_sensorCount) - 1.0)/2.0;
+    for (std::size_t index = 0; index < CAPACITY; index++)
+    {
+        _positions[index] = static_cast<float>((static_cast<double>(index) - center)*_config.spacing);
+        updateCalibration(index);
+    }
+}
+
+void LineTracker::updateCalibration(std::size_t index)
+{
+    float range = static_cast<float>(_lineValues[index]) - static_cast<float>(_floorValues[index]);
+    _offsets[index] = _floorValues[index];
+    // Unused sensors and sensors without range always read 0
+    _scales[index] = index < _sensorCount && range != 0.0f ? 1.0f/range : 0.0f;
+}
+
+void LineTracker::publish()
+{
+    _seqLock.writeBegin();
+    for (std::size_t index = 0; index < CAPACITY; index++)
+        _publishedReadings[index].store(_readings[index], std::memory_order_relaxed);
+    _position.store(_estimate.position, std::memory_order_relaxed);
+    _confidence.store(_estimate.confidence, std::memory_order_relaxed);
+    _time.store(_estimate.time.time_since_epoch().count(), std::memory_order_relaxed);
+    _updateCount.store(_estimate.updateCount, std::memory_order_relaxed);
+    _seqLock.writeEnd();
+}
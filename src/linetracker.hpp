@@ -0,0 +1,93 @@
+#ifndef LINETRACKER_HPP
+#define LINETRACKER_HPP
+
+#include "seqlock.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+
+//! @brief Position of the line under a bar of line track sensors, from their raw values.
+//! The raw values are calibrated into [0, 1] readings kept in aligned buffers, and the line position
+//! is their weighted centroid, computed with SIMD at each new raw value and published without lock.
+class LineTracker
+{
+public:
+    //! Maximum number of line track sensors, as many as the robot values of one sensor family
+    static constexpr std::size_t CAPACITY = 16;
+
+    struct Config
+    {
+        std::size_t sensorCount = 0; //!< Number of sensors of the bar, 0 to use the greatest index received
+        double spacing = 1.0; //!< Distance between two sensors, in the unit of the position
+        float noiseFloor = 0.1f; //!< Readings below it are ignored, to not pull the position to the center
+        bool isLineDark = false; //!< True if the line gives lower raw values than the floor
+    };
+
+    struct Estimate
+    {
+        double position; //!< Distance from the bar center to the line, positive to the left (greater index)
+        double confidence; //!< Greatest calibrated reading in [0, 1], 0 if no sensor sees the line
+        std::chrono::steady_clock::time_point time; //!< Receive time of the last raw value used
+        int updateCount; //!< Number of estimates since the creation
+    };
+
+    LineTracker(const Config & config);
+
+    void setConfig(const Config & config);
+
+    //! @brief Set the raw values of the floor and of the line for one sensor, the default is 0 and 255
+    //! (255 and 0 if the line is dark).
+    void setCalibration(std::size_t index, std::uint8_t floorValue, std::uint8_t lineValue);
+
+    //! @brief Record the range of the raw values of each sensor until stopCalibration, to use it as
+    //! calibration. The bar must sweep over the line and the floor meanwhile.
+    void startCalibration();
+    void stopCalibration();
+
+    //! @brief Take a new raw value of one sensor and update the estimate.
+    //! @return False if index is out of capacity.
+    bool update(std::size_t index, std::uint8_t rawValue, std::chrono::steady_clock::time_point time);
+
+    //! @return A consistent copy of the last estimate, without blocking update.
+    Estimate estimate() const;
+
+    //! @return The last calibrated reading of one sensor, in [0, 1].
+    float reading(std::size_t index) const;
+
+private:
+    LineTracker(const LineTracker &) = delete;
+    LineTracker & operator=(const LineTracker &) = delete;
+
+    void updatePositions();
+    void updateCalibration(std::size_t index);
+    void publish();
+
+    std::mutex _mutex; //!< Serialize the writers, the readers use the seqlock only
+    Config _config;
+    std::size_t _sensorCount;
+    bool _isCalibrating;
+    std::array<std::uint8_t, CAPACITY> _floorValues;
+    std::array<std::uint8_t, CAPACITY> _lineValues;
+    std::array<std::uint8_t, CAPACITY> _calibrationMins;
+    std::array<std::uint8_t, CAPACITY> _calibrationMaxs;
+    // Structure of arrays, aligned for the vector operations of update
+    alignas(64) std::array<float, CAPACITY> _rawValues;
+    alignas(64) std::array<float, CAPACITY> _offsets; //!< Raw value giving a 0 reading
+    alignas(64) std::array<float, CAPACITY> _scales; //!< Reading per raw value, 0 for the unused sensors
+    alignas(64) std::array<float, CAPACITY> _positions;
+    alignas(64) std::array<float, CAPACITY> _readings;
+    Estimate _estimate; //!< Only used by the writers
+
+    SeqLock _seqLock;
+    std::array<std::atomic<float>, CAPACITY> _publishedReadings;
+    std::atomic<double> _position;
+    std::atomic<double> _confidence;
+    std::atomic<std::chrono::steady_clock::rep> _time;
+    std::atomic<int> _updateCount;
+};
+
+#endif
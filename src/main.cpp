@@ -1,48 +1,107 @@
 #include "robot.hpp"
 
+#include <asio/co_spawn.hpp>
 #include <iostream>
 #include <cstdlib>
 #include <sstream>
 #include <thread>
+#include <vector>
+#include <memory>
+#include <stdexcept>
 
 using namespace std::chrono_literals;
 
 
+asio::awaitable<void> followLine(Robot & robot)
+{
+    const std::set<EventType> eventTypes = {EventType::LINE_TRACKS_IS_DETECTED, EventType::SWITCHS_IS_DETECTED};
+    while (!robot.isReplayEnded())
+    {
+        auto event = co_await robot.changed(eventTypes, 0.5s);
+        bool lineTrackValue = robot.getLineTracksIsDetected(0);
+        if (!event.has_value())
+            robot.setMotorsPower(0.5, 0.5);
+        else if (event.value() == EventType::LINE_TRACKS_IS_DETECTED)
+            if (lineTrackValue)
+                robot.setMotorsPower(-0.2, 0.2);
+            else
+                robot.setMotorsPower(-0.1, 0.1);
+        else if (event.value() == EventType::SWITCHS_IS_DETECTED)
+            robot.setMotorsPower(-0.5, -0.3);
+        else
+            std::cout << "error" << std::endl;
+    }
+}
+
 int main(int argc, char ** argv)
 {
     std::string hostIpAddress("127.0.0.1");
     uint16_t tcpPort = 6543;
+    std::string recordPath;
+    std::string replayPath;
+    int latencyDumpPeriod = 0;
+    WireEncoding wireEncoding = WireEncoding::JSON;
 
-    if (argc == 3)
+    std::vector<std::string> args(argv + 1, argv + argc);
+    for (std::size_t i = 0; i + 1 < args.size(); i += 2)
     {
-        hostIpAddress = std::string(argv[1]);
-        std::istringstream iss(argv[2]);
-        iss.exceptions(std::istringstream::failbit);
-        iss >> tcpPort;
+        if (args[i] == "--record")
+            recordPath = args[i+1];
+        else if (args[i] == "--replay")
+            replayPath = args[i+1];
+        else if (args[i] == "--encoding")
+        {
+            if (args[i+1] == "binary")
+                wireEncoding = WireEncoding::BINARY;
+            else if (args[i+1] != "json")
+                throw std::invalid_argument(std::string("Unknown encoding ") + args[i+1]);
+        }
+        else if (args[i] == "--latency-dump")
+        {
+            std::istringstream iss(args[i+1]);
+            iss.exceptions(std::istringstream::failbit);
+            iss >> latencyDumpPeriod;
+        }
+        else
+        {
+            hostIpAddress = args[i];
+            std::istringstream iss(args[i+1]);
+            iss.exceptions(std::istringstream::failbit);
+            iss >> tcpPort;
+        }
     }
 
-    std::cout << "Try to connect to " << hostIpAddress << ":" << tcpPort << " ..." << std::endl;
-    Robot robot(hostIpAddress, tcpPort);
+    std::unique_ptr<Robot> robotPtr;
+    if (replayPath.empty())
+    {
+        std::cout << "Try to connect to " << hostIpAddress << ":" << tcpPort << " ..." << std::endl;
+        robotPtr = std::make_unique<Robot>(hostIpAddress, tcpPort);
+    }
+    else
+    {
+        std::cout << "Replay " << replayPath << " ..." << std::endl;
+        robotPtr = std::make_unique<Robot>(replayPath, Robot::ReplaySpeed::REAL_TIME);
+    }
+    Robot & robot = *robotPtr;
+    if (wireEncoding != WireEncoding::JSON && robot.negotiateWireEncoding(wireEncoding) != wireEncoding)
+        std::cout << "Binary encoding not supported by the robot server, keep json" << std::endl;
+    if (!recordPath.empty())
+        robot.startRecording(recordPath);
+    if (latencyDumpPeriod > 0)
+    {
+        robot.setLatencyInstrumented(true);
+        robot.startLatencyDump(std::chrono::milliseconds(latencyDumpPeriod), std::cout);
+    }
     robot.waitReady();
 
     try
     {
-        while (true)
-        {
-            auto event = robot.waitChanged({EventType::LINE_TRACKS_IS_DETECTED, EventType::SWITCHS_IS_DETECTED}, 0.5s);
-            bool lineTrackValue = robot.getLineTracksIsDetected(0);
-            if (!event.has_value())
-                robot.setMotorsPower(0.5, 0.5);
-            else if (event.value() == EventType::LINE_TRACKS_IS_DETECTED)
-                if (lineTrackValue)
-                    robot.setMotorsPower(-0.2, 0.2);
-                else
-                    robot.setMotorsPower(-0.1, 0.1);
-            else if (event.value() == EventType::SWITCHS_IS_DETECTED)
-                robot.setMotorsPower(-0.5, -0.3);
-            else
-                std::cout << "error" << std::endl;
-        }
+        // Behaviors are coroutines sharing the robot context thread
+        asio::co_spawn(robot.ioContext(), followLine(robot), [](std::exception_ptr exceptionPtr){
+            if (exceptionPtr)
+                std::rethrow_exception(exceptionPtr);
+        });
+        robot.ioContext().run();
     }
     catch (std::exception & e)
     {
@@ -0,0 +1,153 @@
+#include "motorscommandwriter.hpp"
+
+#include <asio/post.hpp>
+#include <future>
+#include <utility>
+
+
+MotorsCommandWriter::MotorsCommandWriter(const Send & send, std::optional<asio::any_io_executor> executor)
+    : _send(send)
+    , _mutex()
+    , _cv()
+    , _pendingRightValue()
+    , _pendingLeftValue()
+    , _period(0)
+    , _sendException()
+    , _isStopping(false)
+    , _thread()
+    , _strand()
+    , _timer()
+    , _isWriteScheduled(false)
+    , _isWriting(false)
+    , _lastSendTime()
+{
+    if (executor.has_value())
+    {
+        _strand = asio::make_strand(executor.value());
+        _timer = std::make_unique<asio::steady_timer>(_strand.value());
+    }
+    else
+        _thread = std::thread([](MotorsCommandWriter * thus){thus->write();}, this);
+}
+
+MotorsCommandWriter::~MotorsCommandWriter()
+{
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _isStopping = true;
+    }
+    _cv.notify_one();
+    if (_thread.joinable())
+    {
+        _thread.join();
+        return;
+    }
+
+    // Skip the period wait of the scheduled write, then wait for its end
+    std::promise<void> timerCancelled;
+    asio::post(_strand.value(), [this, &timerCancelled]{
+        _timer->cancel();
+        timerCancelled.set_value();
+    });
+    timerCancelled.get_future().wait();
+    std::unique_lock<std::mutex> lk(_mutex);
+    _cv.wait(lk, [this]{return !_isWriteScheduled && !_isWriting;});
+}
+
+void MotorsCommandWriter::setPeriod(std::chrono::nanoseconds period)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    _period = period;
+}
+
+void MotorsCommandWriter::setPower(std::optional<float> rightValue, std::optional<float> leftValue)
+{
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        if (_sendException)
+            std::rethrow_exception(std::exchange(_sendException, nullptr));
+        if (rightValue.has_value())
+            _pendingRightValue = rightValue;
+        if (leftValue.has_value())
+            _pendingLeftValue = leftValue;
+        if (_strand.has_value())
+        {
+            if (!_isWriteScheduled)
+            {
+                _isWriteScheduled = true;
+                asio::post(_strand.value(), [this]{asyncWrite();});
+            }
+            return;
+        }
+    }
+    _cv.notify_one();
+}
+
+void MotorsCommandWriter::write()
+{
+    auto lastSendTime = std::chrono::steady_clock::time_point();
+    std::unique_lock<std::mutex> lk(_mutex);
+    while (true)
+    {
+        // Wait for a new command
+        _cv.wait(lk, [this]{return _isStopping || _pendingRightValue.has_value() || _pendingLeftValue.has_value();});
+        if (!_pendingRightValue.has_value() && !_pendingLeftValue.has_value())
+            return;
+
+        // Respect the send rate, the commands received meanwhile replace the pending ones
+        if (!_isStopping)
+            _cv.wait_until(lk, lastSendTime + _period, [this]{return _isStopping;});
+
+        std::optional<float> rightValue = std::exchange(_pendingRightValue, std::nullopt);
+        std::optional<float> leftValue = std::exchange(_pendingLeftValue, std::nullopt);
+        lk.unlock();
+        try
+        {
+            _send(rightValue, leftValue);
+        }
+        catch (...)
+        {
+            lk.lock();
+            _sendException = std::current_exception();
+            continue;
+        }
+        lastSendTime = std::chrono::steady_clock::now();
+        lk.lock();
+    }
+}
+
+void MotorsCommandWriter::asyncWrite()
+{
+    std::unique_lock<std::mutex> lk(_mutex);
+
+    // Respect the send rate, the commands received meanwhile replace the pending ones
+    auto sendTime = _lastSendTime + _period;
+    if (!_isStopping && std::chrono::steady_clock::now() < sendTime)
+    {
+        _timer->expires_at(sendTime);
+        _timer->async_wait([this](const asio::error_code &){asyncWrite();});
+        return;
+    }
+
+    std::optional<float> rightValue = std::exchange(_pendingRightValue, std::nullopt);
+    std::optional<float> leftValue = std::exchange(_pendingLeftValue, std::nullopt);
+    _isWriteScheduled = false;
+    _isWriting = true;
+    lk.unlock();
+    std::exception_ptr sendException;
+    try
+    {
+        _send(rightValue, leftValue);
+    }
+    catch (...)
+    {
+        sendException = std::current_exception();
+    }
+    lk.lock();
+    if (sendException)
+        _sendException = sendException;
+    else
+        _lastSendTime = std::chrono::steady_clock::now();
+    _isWriting = false;
+    _cv.notify_all();
+}
@@ -0,0 +1,67 @@
+#ifndef MOTORSCOMMANDWRITER_HPP
+#define MOTORSCOMMANDWRITER_HPP
+
+#include <asio/any_io_executor.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+
+//! @brief Send motors commands from a dedicated thread (or a shared executor) so the control threads
+//! never block on the socket.
+//! Only the last power of each motor is kept until it is sent: superseded commands are dropped and
+//! the powers of both motors set separately are sent in one message.
+class MotorsCommandWriter
+{
+public:
+    //! @param send Called from the writer thread with the powers to send, an empty value for a motor
+    //! which has not been changed since the last send.
+    //! @param executor Call send from this executor (one call at a time) instead of a dedicated thread.
+    using Send = std::function<void(std::optional<float> rightValue, std::optional<float> leftValue)>;
+    MotorsCommandWriter(const Send & send, std::optional<asio::any_io_executor> executor = std::nullopt);
+
+    //! @brief Send the last pending powers then stop the writer thread.
+    //! @warning With an executor, it must be run by another thread until the end of the destructor.
+    ~MotorsCommandWriter();
+
+    //! @brief Set the minimum duration between two sends, zero to send as soon as the previous send
+    //! is done.
+    void setPeriod(std::chrono::nanoseconds period);
+
+    //! @brief Set the new power of one or both motors, to send as soon as possible.
+    //! @throw The exception thrown by the previous send if any.
+    void setPower(std::optional<float> rightValue, std::optional<float> leftValue);
+
+private:
+    MotorsCommandWriter(const MotorsCommandWriter &) = delete;
+    MotorsCommandWriter & operator=(const MotorsCommandWriter &) = delete;
+
+    void write();
+    void asyncWrite();
+
+    Send _send;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::optional<float> _pendingRightValue;
+    std::optional<float> _pendingLeftValue;
+    std::chrono::nanoseconds _period;
+    std::exception_ptr _sendException;
+    bool _isStopping;
+    std::thread _thread;
+    // Only with an executor
+    std::optional<asio::strand<asio::any_io_executor>> _strand;
+    std::unique_ptr<asio::steady_timer> _timer;
+    bool _isWriteScheduled; //!< An asyncWrite is posted or waits the period
+    bool _isWriting;
+    std::chrono::steady_clock::time_point _lastSendTime;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "odometry.hpp"
+
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+
+Odometry::Odometry(const Config & config)
+    : _mutex()
+    , _config()
+    , _lastTicks()
+    , _wheelDistances()
+    , _pose()
+    , _heading(0.0)
+    , _distance(0.0)
+    , _speedWindowBeginTime()
+    , _speedWindowBeginHeading(0.0)
+    , _speedWindowBeginDistance(0.0)
+    , _seqLock()
+    , _x(0.0)
+    , _y(0.0)
+    , _theta(0.0)
+    , _v(0.0)
+    , _omega(0.0)
+    , _time(0)
+    , _updateCount(0)
+{
+    setConfig(config);
+}
+
+void Odometry::setConfig(const Config & config)
+{
+    if (config.wheelBase <= 0.0 || config.ticksPerUnit <= 0.0)
+        throw std::invalid_argument(std::string("Invalid odometry config: wheel base ") + std::to_string(config.wheelBase)
+                + " and ticks per unit " + std::to_string(config.ticksPerUnit) + " must be positive");
+    std::lock_guard<std::mutex> lk(_mutex);
+    _config = config;
+}
+
+void Odometry::reset(double x, double y, double theta)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    _pose.x = x;
+    _pose.y = y;
+    _pose.theta = std::remainder(theta, 2.0*std::numbers::pi);
+    _pose.v = 0.0;
+    _pose.omega = 0.0;
+    _pose.updateCount++;
+    _heading = _pose.theta;
+    _speedWindowBeginTime = _pose.time;
+    _speedWindowBeginHeading = _heading;
+    _speedWindowBeginDistance = _distance;
+    publish(_pose);
+}
+
+void Odometry::resetEncoders()
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    for (std::optional<std::int64_t> & lastTicks : _lastTicks)
+        lastTicks.reset();
+}
+
+bool Odometry::update(Wheel wheel, std::int64_t ticks, int direction, std::chrono::steady_clock::time_point time)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    std::optional<std::int64_t> & lastTicks = _lastTicks[static_cast<std::size_t>(wheel)];
+    if (!lastTicks.has_value())
+    {
+        lastTicks = ticks;
+        if (_speedWindowBeginTime == std::chrono::steady_clock::time_point())
+            _speedWindowBeginTime = time;
+        return false;
+    }
+
+    double wheelDistance = static_cast<double>(ticks - lastTicks.value())/_config.ticksPerUnit;
+    if (!_config.isEncoderSigned && direction < 0)
+        wheelDistance = -wheelDistance;
+    lastTicks = ticks;
+    _wheelDistances[static_cast<std::size_t>(wheel)] += wheelDistance;
+
+    // Each wheel is received separately, so only one of them moves at each update
+    double rightDistance = wheel == Wheel::RIGHT ? wheelDistance : 0.0;
+    double leftDistance = wheel == Wheel::LEFT ? wheelDistance : 0.0;
+    double distance = (rightDistance + leftDistance)/2.0;
+    double deltaTheta = (rightDistance - leftDistance)/_config.wheelBase;
+
+    // Integrate along the mean heading of this step
+    double meanTheta = _pose.theta + deltaTheta/2.0;
+    _pose.x += distance*std::cos(meanTheta);
+    _pose.y += distance*std::sin(meanTheta);
+    _pose.theta = std::remainder(_pose.theta + deltaTheta, 2.0*std::numbers::pi);
+    _heading += deltaTheta;
+    _distance += distance;
+
+    std::chrono::duration<double> speedWindow = time - _speedWindowBeginTime;
+    if (speedWindow >= _config.speedWindow && speedWindow.count() > 0.0)
+    {
+        _pose.v = (_distance - _speedWindowBeginDistance)/speedWindow.count();
+        _pose.omega = (_heading - _speedWindowBeginHeading)/speedWindow.count();
+        _speedWindowBeginTime = time;
+        _speedWindowBeginHeading = _heading;
+        _speedWindowBeginDistance = _distance;
+    }
+    _pose.time = time;
+    _pose.updateCount++;
+    publish(_pose);
+    return true;
+}
+
+Odometry::Pose Odometry::pose() const
+{
+    Pose pose;
+    _seqLock.read([this, &pose]{
+        pose.x = _x.load(std::memory_order_relaxed);
+        pose.y = _y.load(std::memory_order_relaxed);
+        pose.theta = _theta.load(std::memory_order_relaxed);
+        pose.v = _v.load(std::memory_order_relaxed);
+        pose.omega = _omega.load(std::memory_order_relaxed);
+        pose.time = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(_time.load(std::memory_order_relaxed)));
+        pose.updateCount = _updateCount.load(std::memory_order_relaxed);
+    });
+    return pose;
+}
+
+double Odometry::wheelDistance(Wheel wheel) const
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    return _wheelDistances[static_cast<std::size_t>(wheel)];
+}
+
+void Odometry::publish(const Pose & pose)
+{
+    _seqLock.writeBegin();
+    _x.store(pose.x, std::memory_order_relaxed);
+    _y.store(pose.y, std::memory_order_relaxed);
+    _theta.store(pose.theta, std::memory_order_relaxed);
+    _v.store(pose.v, std::memory_order_relaxed);
+    _omega.store(pose.omega, std::memory_order_relaxed);
+    _time.store(pose.time.time_since_epoch().count(), std::memory_order_relaxed);
+    _updateCount.store(pose.updateCount, std::memory_order_relaxed);
+    _seqLock.writeEnd();
+}
@@ -0,0 +1,92 @@
+#ifndef ODOMETRY_HPP
+#define ODOMETRY_HPP
+
+#include "seqlock.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+
+//! @brief Dead reckoning of a differential drive robot from its two encoder wheels.
+//! The pose is integrated incrementally at each encoder value and published without lock, so it can
+//! be read in O(1) from any thread.
+class Odometry
+{
+public:
+    struct Config
+    {
+        double wheelBase = 50.0; //!< Distance between the two wheels, in unit
+        double ticksPerUnit = 2.0; //!< Encoder wheel ticks for one unit traveled by the wheel
+        //! If false the encoder counts the absolute distance, and the wheel direction is given to update
+        bool isEncoderSigned = false;
+        //! Minimum duration over which the speeds are measured, to smooth the encoder resolution
+        std::chrono::nanoseconds speedWindow = std::chrono::milliseconds(50);
+    };
+
+    struct Pose
+    {
+        double x; //!< In unit, along the initial heading
+        double y; //!< In unit, to the left of the initial heading
+        double theta; //!< Heading in radian, in ]-pi, pi]
+        double v; //!< Linear speed in unit per second
+        double omega; //!< Angular speed in radian per second
+        std::chrono::steady_clock::time_point time; //!< Receive time of the last encoder value integrated
+        int updateCount; //!< Number of pose updates since the creation
+    };
+
+    enum class Wheel {RIGHT = 0, LEFT = 1};
+
+    Odometry(const Config & config);
+
+    //! @brief Change the config, the pose is kept.
+    void setConfig(const Config & config);
+
+    //! @brief Set the pose, the speeds are reset.
+    void reset(double x, double y, double theta);
+
+    //! @brief Forget the last encoder values, when the encoders may have been reset. The pose is kept,
+    //! and the next value of each wheel is only used as a new reference.
+    void resetEncoders();
+
+    //! @brief Integrate a new encoder value of one wheel.
+    //! @param direction Sign of the wheel motion since the previous value, ignored if the encoder is signed.
+    //! @return True if the pose has been updated, false for the first value of this wheel.
+    bool update(Wheel wheel, std::int64_t ticks, int direction, std::chrono::steady_clock::time_point time);
+
+    //! @return A consistent copy of the last pose, without blocking update.
+    Pose pose() const;
+
+    //! @return The signed distance traveled by one wheel since the creation, in unit.
+    double wheelDistance(Wheel wheel) const;
+
+private:
+    Odometry(const Odometry &) = delete;
+    Odometry & operator=(const Odometry &) = delete;
+
+    void publish(const Pose & pose);
+
+    mutable std::mutex _mutex; //!< Serialize the writers and wheelDistance, the pose readers use the seqlock only
+    Config _config;
+    std::optional<std::int64_t> _lastTicks[2];
+    double _wheelDistances[2];
+    Pose _pose; //!< Integration state, only used by the writers
+    double _heading; //!< Theta without normalization, to measure the angular speed
+    double _distance; //!< Distance traveled by the robot center since the creation, to measure the linear speed
+    std::chrono::steady_clock::time_point _speedWindowBeginTime;
+    double _speedWindowBeginHeading;
+    double _speedWindowBeginDistance;
+
+    SeqLock _seqLock;
+    std::atomic<double> _x;
+    std::atomic<double> _y;
+    std::atomic<double> _theta;
+    std::atomic<double> _v;
+    std::atomic<double> _omega;
+    std::atomic<std::chrono::steady_clock::rep> _time;
+    std::atomic<int> _updateCount;
+};
+
+#endif
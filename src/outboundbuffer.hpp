@@ -0,0 +1,155 @@
+#ifndef OUTBOUNDBUFFER_HPP
+#define OUTBOUNDBUFFER_HPP
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+//! @brief Reusable buffer of one outbound message, formatted in place.
+//! Its capacity only grows, so a buffer reused from OutboundBufferPool formats without allocation.
+class OutboundBuffer
+{
+public:
+    static constexpr std::size_t INITIAL_CAPACITY = 256;
+
+    OutboundBuffer() : _data() {_data.reserve(INITIAL_CAPACITY);}
+
+    void clear() {_data.clear();}
+    std::string_view view() const {return _data;}
+    std::size_t size() const {return _data.size();}
+
+    OutboundBuffer & append(std::string_view text) {_data.append(text); return *this;}
+    OutboundBuffer & append(char c) {_data.push_back(c); return *this;}
+
+    //! @name Append a JSON value
+    //! The numbers are written with std::to_chars, as the shortest text read back as the same value,
+    //! and the non finite ones as null since JSON has no NaN nor infinity.
+    //! \{
+    OutboundBuffer & appendJson(float value) {return appendJsonNumber(value);}
+    OutboundBuffer & appendJson(double value) {return appendJsonNumber(value);}
+    OutboundBuffer & appendJson(std::int64_t value) {return appendChars(value);}
+    //! @brief Append a JSON string, with its quotes, backslashes and control characters escaped.
+    OutboundBuffer & appendJson(std::string_view text)
+    {
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+        _data.push_back('"');
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                _data.push_back('\\');
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                _data.append("\\u00");
+                _data.push_back(HEX_DIGITS[(c >> 4) & 0xF]);
+                _data.push_back(HEX_DIGITS[c & 0xF]);
+                continue;
+            }
+            _data.push_back(c);
+        }
+        _data.push_back('"');
+        return *this;
+    }
+    //! \}
+
+private:
+    template<typename T>
+    OutboundBuffer & appendJsonNumber(T value)
+    {
+        if (!std::isfinite(value))
+            return append("null");
+        return appendChars(value);
+    }
+
+    template<typename T>
+    OutboundBuffer & appendChars(T value)
+    {
+        char chars[32];
+        auto result = std::to_chars(chars, chars + sizeof(chars), value);
+        _data.append(chars, result.ptr);
+        return *this;
+    }
+
+    std::string _data;
+};
+
+//! @brief Free list of OutboundBuffer shared by the sending threads.
+//! A buffer is only allocated when all the existing ones are in use, so the steady state of a client
+//! does not allocate whatever the number of concurrent senders.
+class OutboundBufferPool
+{
+public:
+    OutboundBufferPool() : _mutex(), _buffers(), _freeBuffers() {}
+
+    //! @return An empty buffer, to give back with release.
+    OutboundBuffer * acquire()
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        if (_freeBuffers.empty())
+        {
+            _buffers.push_back(std::make_unique<OutboundBuffer>());
+            // Room for all the buffers, so release never allocates
+            _freeBuffers.reserve(_buffers.size());
+            return _buffers.back().get();
+        }
+        OutboundBuffer * buffer = _freeBuffers.back();
+        _freeBuffers.pop_back();
+        buffer->clear();
+        return buffer;
+    }
+
+    void release(OutboundBuffer * buffer)
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _freeBuffers.push_back(buffer);
+    }
+
+    //! @return The number of buffers allocated since the creation.
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _buffers.size();
+    }
+
+private:
+    OutboundBufferPool(const OutboundBufferPool &) = delete;
+    OutboundBufferPool & operator=(const OutboundBufferPool &) = delete;
+
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<OutboundBuffer>> _buffers;
+    std::vector<OutboundBuffer *> _freeBuffers;
+};
+
+//! @brief Stream buffer appending to an OutboundBuffer, to serialize a Json::Value in place.
+class OutboundStreambuf : public std::streambuf
+{
+public:
+    OutboundStreambuf() : _buffer(nullptr) {}
+
+    void setBuffer(OutboundBuffer * buffer) {_buffer = buffer;}
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            _buffer->append(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char * text, std::streamsize size) override
+    {
+        _buffer->append(std::string_view(text, static_cast<std::size_t>(size)));
+        return size;
+    }
+
+private:
+    OutboundBuffer * _buffer;
+};
+
+#endif
@@ -1,89 +1,539 @@
 #include "robot.hpp"
 
 #include <json/value.h>
+#include <asio/async_result.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/post.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
+#include <asio/this_coro.hpp>
+#include <asio/use_awaitable.hpp>
+#include <algorithm>
 #include <iostream>
+#include <iomanip>
 
 
+namespace
+{
+    //! @return The event of a sensor notification, they are declared in the same order.
+    constexpr EventType toEventType(IndexedValueMethod method)
+    {
+        return static_cast<EventType>(method);
+    }
+    static_assert(toEventType(IndexedValueMethod::IR_PROXIMITY_DISTANCE_DETECTED) == EventType::IR_PROXIMITYS_DISTANCE_DETECTED);
+    static_assert(toEventType(IndexedValueMethod::LINE_TRACK_IS_DETECTED) == EventType::LINE_TRACKS_IS_DETECTED);
+    static_assert(toEventType(IndexedValueMethod::LINE_TRACK_VALUE) == EventType::LINE_TRACKS_VALUE);
+    static_assert(toEventType(IndexedValueMethod::ENCODER_WHEEL_VALUE) == EventType::ENCODER_WHEELS_VALUE);
+    static_assert(toEventType(IndexedValueMethod::SWITCH_IS_DETECTED) == EventType::SWITCHS_IS_DETECTED);
+    static_assert(toEventType(IndexedValueMethod::ULTRASOUND_DISTANCE_DETECTED) == EventType::ULTRASOUNDS_DISTANCE_DETECTED);
+    static_assert(INDEXED_VALUE_METHOD_COUNT < EVENT_TYPE_COUNT, "The events after the sensor notifications are computed by Robot");
+
+    std::int64_t toNanoseconds(std::chrono::steady_clock::time_point timePoint)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count();
+    }
+
+    std::int64_t telemetryTimestamp()
+    {
+        return toNanoseconds(std::chrono::steady_clock::now());
+    }
+
+    const char * const EVENT_TYPE_NAMES[EVENT_TYPE_COUNT] = {"IR_PROXIMITYS_DISTANCE_DETECTED",
+            "LINE_TRACKS_IS_DETECTED", "LINE_TRACKS_VALUE", "ENCODER_WHEELS_VALUE", "SWITCHS_IS_DETECTED",
+            "ULTRASOUNDS_DISTANCE_DETECTED", "ODOMETRY_UPDATED", "UPDATES_MISSED",
+            "LINE_POSITION_UPDATED"};
+    const char * const LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT] = {"RECEIVE_TO_PARSE", "PARSE_TO_SET",
+            "SET_TO_WAKEUP", "WAKEUP_TO_WRITE", "RECEIVE_TO_WRITE"};
+
+    //! @brief Last event which has woken up the current thread, to know what caused its next motors command.
+    struct WakeUp
+    {
+        const void * robot;
+        EventType eventType;
+        std::int64_t receiveTime;
+        std::int64_t wakeUpTime;
+    };
+    thread_local WakeUp lastWakeUp = {nullptr, EventType::IR_PROXIMITYS_DISTANCE_DETECTED, 0, 0};
+
+    //! Longest time between two notifications of a telemetry log, a longer one is a corrupt timestamp
+    constexpr std::chrono::nanoseconds MAX_REPLAY_GAP = std::chrono::minutes(1);
+
+    //! @brief State shared by the event dispatcher callback and the timeout timer of one asyncWaitChanged.
+    struct AsyncChanged
+    {
+        AsyncChanged(const asio::any_io_executor & executorParam, std::function<void(std::optional<EventType>)> completionParam)
+            : executor(executorParam), strand(asio::make_strand(executorParam)), timer(strand), isCompleted(false)
+            , asyncWaitId(0), completion(std::move(completionParam)) {}
+
+        //! @brief Call the completion on its executor, only for the first caller.
+        void complete(const std::shared_ptr<AsyncChanged> & thus, std::optional<EventType> notifiedEventType)
+        {
+            if (isCompleted.exchange(true))
+                return;
+            asio::post(executor, [thus, notifiedEventType]{thus->completion(notifiedEventType);});
+        }
+
+        asio::any_io_executor executor;
+        asio::strand<asio::any_io_executor> strand; //!< Serialize the timer operations
+        asio::steady_timer timer;
+        std::atomic<bool> isCompleted;
+        std::uint64_t asyncWaitId; //!< Only used from the strand
+        std::function<void(std::optional<EventType>)> completion;
+    };
+}
+
 Robot::Robot(const std::string & hostIpAddress, uint16_t tcpPort)
-    : _jsonRpcTcpClient(hostIpAddress, tcpPort)
-    , _irProximitysDistanceDetected(this)
-    , _lineTracksIsDetected(this)
-    , _lineTracksValue(this)
-    , _encoderWheelsValue(this)
-    , _switchsIsDetected(this)
-    , _ultrasoundsDistanceDetected(this)
-    , _isReadySemaphore(0)
-    , _eventCvMutex()
-    , _eventCv()
-{
-    _jsonRpcTcpClient.bindNotification("irProximityDistanceDetected", [this](const Json::Value & params){
-        std::size_t index = params["index"].asUInt();
-        _irProximitysDistanceDetected.set(index, params["value"].asUInt(), params["changedCount"].asInt());
-    });
-    _jsonRpcTcpClient.bindNotification("lineTrackIsDetected", [this](const Json::Value & params){
-        std::size_t index = params["index"].asUInt();
-        _lineTracksIsDetected.set(index, params["value"].asBool(), params["changedCount"].asInt());
-    });
-    _jsonRpcTcpClient.bindNotification("lineTrackValue", [this](const Json::Value & params){
-        std::size_t index = params["index"].asUInt();
-        _lineTracksValue.set(index, params["value"].asUInt(), params["changedCount"].asInt());
-    });
-    _jsonRpcTcpClient.bindNotification("encoderWheelValue", [this](const Json::Value & params){
-        std::size_t index = params["index"].asUInt();
-        _encoderWheelsValue.set(index, params["value"].asUInt(), params["changedCount"].asInt());
-    });
-    _jsonRpcTcpClient.bindNotification("switchIsDetected", [this](const Json::Value & params){
-        std::size_t index = params["index"].asUInt();
-        _switchsIsDetected.set(index, params["value"].asBool(), params["changedCount"].asInt());
-    });
-    _jsonRpcTcpClient.bindNotification("ultrasoundDistanceDetected", [this](const Json::Value & params){
-        std::size_t index = params["index"].asUInt();
-        _ultrasoundsDistanceDetected.set(index, params["value"].asUInt(), params["changedCount"].asInt());
-    });
-    _jsonRpcTcpClient.bindNotification("setIsReady", [this](const Json::Value & params){
+    : Robot(std::make_unique<JsonRpcTcpClient>(hostIpAddress, tcpPort), std::nullopt)
+{
+    bindNotificationsAndStartReceive();
+}
+
+Robot::Robot(asio::io_context & ioContext, const std::string & hostIpAddress, uint16_t tcpPort)
+    : Robot(std::make_unique<JsonRpcTcpClient>(ioContext, hostIpAddress, tcpPort), ioContext.get_executor())
+{
+    bindNotificationsAndStartReceive();
+}
+
+void Robot::bindNotificationsAndStartReceive()
+{
+    _jsonRpcTcpClient->bindIndexedValueNotifications(*this);
+    _jsonRpcTcpClient->bindNotification("setIsReady", [this](const Json::Value & params){
         assert(params.isNull());
-        _isReadySemaphore.release();
+        setIsReady(true);
     });
-    _jsonRpcTcpClient.startReceive();
+    _jsonRpcTcpClient->bindConnection([this](bool isConnected){connectionChanged(isConnected);});
+    _jsonRpcTcpClient->startReceive();
 }
 
-Robot::~Robot()
+Robot::Robot(const std::string & telemetryLogPath, ReplaySpeed replaySpeed)
+    : Robot(std::unique_ptr<JsonRpcTcpClient>(), std::nullopt)
+{
+    _telemetryLog = std::make_unique<TelemetryLog>(telemetryLogPath);
+    _replayIoContext = std::make_unique<asio::io_context>();
+    _replayThread = std::thread([](Robot * thus, ReplaySpeed speed){thus->replay(speed);}, this, replaySpeed);
+}
+
+Robot::Robot(std::unique_ptr<JsonRpcTcpClient> jsonRpcTcpClient, std::optional<asio::any_io_executor> writerExecutor)
+    : _sensorsSeqLock()
+    , _irProximitysDistanceDetected(this, _sensorsSeqLock)
+    , _lineTracksIsDetected(this, _sensorsSeqLock)
+    , _lineTracksValue(this, _sensorsSeqLock)
+    , _encoderWheelsValue(this, _sensorsSeqLock)
+    , _switchsIsDetected(this, _sensorsSeqLock)
+    , _ultrasoundsDistanceDetected(this, _sensorsSeqLock)
+    , _odometry(Odometry::Config())
+    , _motorDirections()
+    , _lineTracker(LineTracker::Config())
+    , _wheelSpeedController(WheelSpeedController::Config(), [this](Odometry::Wheel wheel, float power){
+            // The writer sends it from its own thread, so the reception never blocks on the socket
+            if (wheel == Odometry::Wheel::RIGHT)
+                _motorsCommandWriter.setPower(power, std::nullopt);
+            else
+                _motorsCommandWriter.setPower(std::nullopt, power);})
+    , _subscriptionsMutex()
+    , _subscriptions(std::make_shared<const Subscriptions>())
+    , _hasSubscriptions(false)
+    , _missedUpdateCount(0)
+    , _missedUpdateEventCount(0)
+    , _outOfRangeUpdateCount(0)
+    , _isResendOnMissedUpdates(false)
+    , _isResendPending(false)
+    , _isReadyMutex()
+    , _isReadyCv()
+    , _isReady(false)
+    , _isResuming(false)
+    , _disconnectTime(0)
+    , _lastResumeDuration(-1)
+    , _eventDispatcher()
+    , _asyncWaitGuard(std::make_shared<AsyncWaitGuard>(&_eventDispatcher))
+    , _isRecording(false)
+    , _telemetryRecorderMutex()
+    , _telemetryRecorder()
+    , _telemetryLog()
+    , _isReplayStopping(false)
+    , _replayMutex()
+    , _replayCv()
+    , _isReplayEnded(false)
+    , _invalidReplayRecordCount(0)
+    , _replayThread()
+    , _replayIoContext()
+    , _isLatencyInstrumented(false)
+    , _latencyHistograms(std::make_unique<LatencyHistograms>())
+    , _lastReceiveTimes()
+    , _lastSetTimes()
+    , _motorsCommandCauseMutex()
+    , _motorsCommandCauseEventType()
+    , _motorsCommandCauseReceiveTime(0)
+    , _motorsCommandCauseWakeUpTime(0)
+    , _latencyDumpMutex()
+    , _latencyDumpCv()
+    , _isLatencyDumpStopping(false)
+    , _latencyDumpThread()
+    , _jsonRpcTcpClient(std::move(jsonRpcTcpClient))
+    , _motorsCommandWriter([this](std::optional<float> rightValue, std::optional<float> leftValue){
+            sendMotorsPower(rightValue, leftValue);}, writerExecutor)
 {}
 
-void Robot::setMotorPower(MotorIndex motorIndex, float value)
+Robot::~Robot()
 {
-    Json::Value params;
-    params["motorIndex"] = motorIndexToStringHelper(motorIndex);
-    params["value"] = value;
-    _jsonRpcTcpClient.callNotification("setMotorPower", params);
+    // Complete the async waits, and cancel their timers, before the client and its io_context are destroyed
+    {
+        std::lock_guard<std::mutex> lk(_asyncWaitGuard->mutex);
+        _asyncWaitGuard->eventDispatcher = nullptr;
+    }
+    _eventDispatcher.cancelAsyncWaits();
+    // The receive thread runs until the destruction of _jsonRpcTcpClient, after _motorsCommandWriter
+    _wheelSpeedController.disable();
+    stopLatencyDump();
+    {
+        std::lock_guard<std::mutex> lk(_replayMutex);
+        _isReplayStopping = true;
+    }
+    _replayCv.notify_all();
+    if (_replayThread.joinable())
+        _replayThread.join();
+    for (const auto & subscription : *_subscriptions.load())
+        subscription->close();
+}
 
+void Robot::waitReady()
+{
+    std::unique_lock<std::mutex> lk(_isReadyMutex);
+    _isReadyCv.wait(lk, [this]{return _isReady;});
 }
+
+std::optional<std::chrono::nanoseconds> Robot::getLastResumeDuration() const
+{
+    std::int64_t lastResumeDuration = _lastResumeDuration;
+    if (lastResumeDuration < 0)
+        return std::nullopt;
+    return std::chrono::nanoseconds(lastResumeDuration);
+}
+
+Robot::Snapshot Robot::snapshot() const
+{
+    Snapshot snapshot;
+    _sensorsSeqLock.read([this, &snapshot]{
+        _irProximitysDistanceDetected.load(snapshot.irProximitysDistanceDetected);
+        _lineTracksIsDetected.load(snapshot.lineTracksIsDetected);
+        _lineTracksValue.load(snapshot.lineTracksValue);
+        _encoderWheelsValue.load(snapshot.encoderWheelsValue);
+        _switchsIsDetected.load(snapshot.switchsIsDetected);
+        _ultrasoundsDistanceDetected.load(snapshot.ultrasoundsDistanceDetected);
+    });
+    snapshot.pose = _odometry.pose();
+    snapshot.linePosition = _lineTracker.estimate();
+    return snapshot;
+}
+
+std::uint64_t Robot::getMissedUpdateCount(EventType eventType, std::size_t index) const
+{
+    switch (eventType)
+    {
+        case EventType::IR_PROXIMITYS_DISTANCE_DETECTED:
+            return _irProximitysDistanceDetected.getMissedCount(index);
+        case EventType::LINE_TRACKS_IS_DETECTED:
+            return _lineTracksIsDetected.getMissedCount(index);
+        case EventType::LINE_TRACKS_VALUE:
+            return _lineTracksValue.getMissedCount(index);
+        case EventType::ENCODER_WHEELS_VALUE:
+            return _encoderWheelsValue.getMissedCount(index);
+        case EventType::SWITCHS_IS_DETECTED:
+            return _switchsIsDetected.getMissedCount(index);
+        case EventType::ULTRASOUNDS_DISTANCE_DETECTED:
+            return _ultrasoundsDistanceDetected.getMissedCount(index);
+        case EventType::ODOMETRY_UPDATED:
+        case EventType::UPDATES_MISSED:
+        case EventType::LINE_POSITION_UPDATED:
+            break;
+    }
+    return 0;
+}
+
+std::uint64_t Robot::getStaleUpdateCount(EventType eventType, std::size_t index) const
+{
+    switch (eventType)
+    {
+        case EventType::IR_PROXIMITYS_DISTANCE_DETECTED:
+            return _irProximitysDistanceDetected.getStaleCount(index);
+        case EventType::LINE_TRACKS_IS_DETECTED:
+            return _lineTracksIsDetected.getStaleCount(index);
+        case EventType::LINE_TRACKS_VALUE:
+            return _lineTracksValue.getStaleCount(index);
+        case EventType::ENCODER_WHEELS_VALUE:
+            return _encoderWheelsValue.getStaleCount(index);
+        case EventType::SWITCHS_IS_DETECTED:
+            return _switchsIsDetected.getStaleCount(index);
+        case EventType::ULTRASOUNDS_DISTANCE_DETECTED:
+            return _ultrasoundsDistanceDetected.getStaleCount(index);
+        case EventType::ODOMETRY_UPDATED:
+        case EventType::UPDATES_MISSED:
+        case EventType::LINE_POSITION_UPDATED:
+            break;
+    }
+    return 0;
+}
+
+void Robot::fetchSensors()
+{
+    if (!_jsonRpcTcpClient)
+        return;
+    std::vector<JsonRpcTcpClient::BatchCall> calls;
+    for (std::string_view methodName : INDEXED_VALUE_METHOD_NAMES)
+    {
+        Json::Value params;
+        params["method"] = std::string(methodName);
+        calls.push_back({SENSOR_VALUES_METHOD, params});
+    }
+
+    // Store the values from the receive thread, as the notifications. The promise is shared with the
+    // response handle, which can still run after a timeout
+    auto fetched = std::make_shared<std::promise<void>>();
+    std::future<void> future = fetched->get_future();
+    int firstJsonRpcId = _jsonRpcTcpClient->callBatchAsync(calls, [this, fetched](std::vector<Json::Value> & responses){
+        auto receiveTime = std::chrono::steady_clock::now();
+        std::string errorMessage;
+        try
+        {
+            for (std::size_t methodIndex = 0; methodIndex < responses.size(); methodIndex++)
+            {
+                const Json::Value & response = responses[methodIndex];
+                if (response.isMember("error"))
+                {
+                    errorMessage = response["error"]["message"].asString();
+                    continue;
+                }
+                EventType eventType = toEventType(static_cast<IndexedValueMethod>(methodIndex));
+                for (const Json::Value & indexedValue : response["result"])
+                {
+                    const Json::Value & value = indexedValue["value"];
+                    receiveValue(eventType, indexedValue["index"].asUInt(), value.isBool() ? value.asBool() : value.asInt64(),
+                            indexedValue["changedCount"].asInt(), receiveTime, receiveTime);
+                }
+            }
+        }
+        catch (...)
+        {
+            fetched->set_exception(std::current_exception());
+            return;
+        }
+        if (errorMessage.empty())
+            fetched->set_value();
+        else
+            fetched->set_exception(std::make_exception_ptr(std::runtime_error(errorMessage)));
+    });
+    if (future.wait_for(_jsonRpcTcpClient->callTimeout()) == std::future_status::timeout)
+    {
+        _jsonRpcTcpClient->cancelMethodCalls(firstJsonRpcId, calls.size());
+        throw std::runtime_error(std::string("No response to ") + SENSOR_VALUES_METHOD + " before the call timeout");
+    }
+    future.get();
+}
+
+std::shared_ptr<Robot::Subscription> Robot::subscribe(const Subscription::Filter & filter, const Subscription::Config & config)
+{
+    auto subscription = std::make_shared<Subscription>(filter, config);
+    std::lock_guard<std::mutex> lk(_subscriptionsMutex);
+    auto subscriptions = std::make_shared<Subscriptions>(*_subscriptions.load());
+    subscriptions->push_back(subscription);
+    _subscriptions.store(subscriptions);
+    _hasSubscriptions = true;
+    return subscription;
+}
+
+std::shared_ptr<Robot::Subscription> Robot::subscribe(const Subscription::Filter & filter, const Subscription::Callback & callback,
+        const Subscription::Config & config)
+{
+    auto subscription = subscribe(filter, config);
+    subscription->startDispatch(callback);
+    return subscription;
+}
+
+void Robot::unsubscribe(const std::shared_ptr<Subscription> & subscription)
+{
+    {
+        std::lock_guard<std::mutex> lk(_subscriptionsMutex);
+        auto subscriptions = std::make_shared<Subscriptions>(*_subscriptions.load());
+        subscriptions->erase(std::remove(subscriptions->begin(), subscriptions->end(), subscription), subscriptions->end());
+        _hasSubscriptions = !subscriptions->empty();
+        _subscriptions.store(subscriptions);
+    }
+    subscription->close();
+}
+
+void Robot::resetPose(double x, double y, double theta)
+{
+    _odometry.reset(x, y, theta);
+    _eventDispatcher.notify(EventType::ODOMETRY_UPDATED, _odometry.pose().updateCount);
+}
+
+void Robot::setMotorPower(MotorIndex motorIndex, float value)
+{
+    _wheelSpeedController.disable();
+    takeMotorsCommandCause();
+    if (motorIndex == MotorIndex::RIGHT)
+        _motorsCommandWriter.setPower(value, std::nullopt);
+    else
+        _motorsCommandWriter.setPower(std::nullopt, value);
+}
+
 void Robot::setMotorsPower(float rightValue, float leftValue)
 {
-    Json::Value params;
-    params["rightValue"] = rightValue;
-    params["leftValue"] = leftValue;
-    _jsonRpcTcpClient.callNotification("setMotorsPower", params);
+    _wheelSpeedController.disable();
+    takeMotorsCommandCause();
+    _motorsCommandWriter.setPower(rightValue, leftValue);
+}
+
+void Robot::startRecording(const std::string & telemetryLogPath)
+{
+    auto telemetryRecorder = std::make_unique<TelemetryRecorder>(telemetryLogPath);
+    std::lock_guard<std::mutex> lk(_telemetryRecorderMutex);
+    _telemetryRecorder = std::move(telemetryRecorder);
+    _isRecording = true;
+}
+
+void Robot::stopRecording()
+{
+    std::lock_guard<std::mutex> lk(_telemetryRecorderMutex);
+    _isRecording = false;
+    _telemetryRecorder.reset();
+}
+
+void Robot::resetLatencyHistograms()
+{
+    for (auto & eventTypeLatencyHistograms : *_latencyHistograms)
+        for (auto & latencyHistogram : eventTypeLatencyHistograms)
+            latencyHistogram.reset();
+}
+
+void Robot::dumpLatencyHistograms(std::ostream & os) const
+{
+    for (std::size_t eventIndex = 0; eventIndex < EVENT_TYPE_COUNT; eventIndex++)
+    {
+        for (std::size_t stageIndex = 0; stageIndex < LATENCY_STAGE_COUNT; stageIndex++)
+        {
+            const LatencyHistogram & latencyHistogram = (*_latencyHistograms)[eventIndex][stageIndex];
+            if (latencyHistogram.count() == 0)
+                continue;
+            os << std::left << std::setw(32) << EVENT_TYPE_NAMES[eventIndex] << std::setw(17)
+               << LATENCY_STAGE_NAMES[stageIndex] << std::right
+               << " count=" << latencyHistogram.count()
+               << " p50_ns=" << latencyHistogram.percentile(0.5).count()
+               << " p99_ns=" << latencyHistogram.percentile(0.99).count()
+               << " max_ns=" << latencyHistogram.max().count() << std::endl;
+        }
+    }
+}
+
+void Robot::startLatencyDump(std::chrono::milliseconds period, std::ostream & os)
+{
+    stopLatencyDump();
+    _isLatencyDumpStopping = false;
+    _latencyDumpThread = std::thread([this, period, &os]{
+        std::unique_lock<std::mutex> lk(_latencyDumpMutex);
+        while (!_latencyDumpCv.wait_for(lk, period, [this]{return _isLatencyDumpStopping;}))
+            dumpLatencyHistograms(os);
+    });
+}
+
+void Robot::stopLatencyDump()
+{
+    {
+        std::lock_guard<std::mutex> lk(_latencyDumpMutex);
+        _isLatencyDumpStopping = true;
+    }
+    _latencyDumpCv.notify_one();
+    if (_latencyDumpThread.joinable())
+        _latencyDumpThread.join();
 }
 
 void Robot::waitChanged(EventType eventType) {
-    auto eventTypes = waitParamHelper({eventType});
-    waitChangedHelper(eventTypes);
+    auto eventTypes = _eventDispatcher.waitParam({eventType});
+    _eventDispatcher.wait(eventTypes);
+    wokenUp(eventType);
 }
 
 EventType Robot::waitChanged(const std::set<EventType> & eventTypes)
 {
-    auto eventTypesWithChangedCount = waitParamHelper(eventTypes);
-    return waitChangedHelper(eventTypesWithChangedCount);
+    auto eventTypesWithChangedCount = _eventDispatcher.waitParam(eventTypes);
+    EventType notifiedEventType = _eventDispatcher.wait(eventTypesWithChangedCount);
+    wokenUp(notifiedEventType);
+    return notifiedEventType;
+}
+
+asio::awaitable<EventType> Robot::changed(std::set<EventType> eventTypes)
+{
+    auto notifiedEventType = co_await changedFor(std::move(eventTypes), std::nullopt);
+    if (!notifiedEventType.has_value())
+        throw std::runtime_error("Robot destroyed while waiting for a change");
+    co_return notifiedEventType.value();
+}
+
+asio::awaitable<std::optional<EventType>> Robot::changedFor(std::set<EventType> eventTypes,
+        std::optional<std::chrono::steady_clock::duration> duration)
+{
+    auto executor = co_await asio::this_coro::executor;
+    auto notifiedEventType = co_await asio::async_initiate<decltype(asio::use_awaitable), void(std::optional<EventType>)>(
+            [this, &eventTypes, duration, executor](auto handler){
+        // The completion must be copyable, the coroutine handler is only movable
+        auto sharedHandler = std::make_shared<decltype(handler)>(std::move(handler));
+        asyncWaitChanged(eventTypes, duration, executor, [sharedHandler](std::optional<EventType> notifiedEventTypeParam){
+            (*sharedHandler)(notifiedEventTypeParam);});
+    }, asio::use_awaitable);
+    if (notifiedEventType.has_value())
+        wokenUp(notifiedEventType.value());
+    co_return notifiedEventType;
+}
+
+void Robot::asyncWaitChanged(const std::set<EventType> & eventTypes, std::optional<std::chrono::steady_clock::duration> duration,
+        const asio::any_io_executor & executor, ChangedCompletion completion)
+{
+    auto asyncChanged = std::make_shared<AsyncChanged>(executor, std::move(completion));
+    auto eventTypesWithChangedCount = _eventDispatcher.waitParam(eventTypes);
+
+    // Start the timer before registering the wait, and from the strand, so a notification cannot cancel
+    // the timer before it has been started. The handlers only reach the robot through the guard.
+    asio::dispatch(asyncChanged->strand, [asyncWaitGuard = _asyncWaitGuard, asyncChanged, eventTypesWithChangedCount, duration]{
+        if (duration.has_value())
+        {
+            asyncChanged->timer.expires_after(duration.value());
+            asyncChanged->timer.async_wait([asyncWaitGuard, asyncChanged](const asio::error_code & ec){
+                if (ec || asyncChanged->isCompleted)
+                    return;
+                {
+                    std::lock_guard<std::mutex> lk(asyncWaitGuard->mutex);
+                    if (asyncWaitGuard->eventDispatcher != nullptr)
+                        asyncWaitGuard->eventDispatcher->cancelAsyncWait(asyncChanged->asyncWaitId);
+                }
+                asyncChanged->complete(asyncChanged, std::nullopt);
+            });
+        }
+        std::lock_guard<std::mutex> lk(asyncWaitGuard->mutex);
+        if (asyncWaitGuard->eventDispatcher == nullptr)
+        {
+            // The robot is destroyed
+            asyncChanged->complete(asyncChanged, std::nullopt);
+            asyncChanged->timer.cancel();
+            return;
+        }
+        // Called with an empty value when the robot is destroyed
+        asyncChanged->asyncWaitId = asyncWaitGuard->eventDispatcher->asyncWait(eventTypesWithChangedCount,
+                [asyncChanged](std::optional<EventType> notifiedEventType){
+            asyncChanged->complete(asyncChanged, notifiedEventType);
+            asio::post(asyncChanged->strand, [asyncChanged]{asyncChanged->timer.cancel();});
+        });
+    });
 }
 
 void Robot::notify(EventType eventType, int changedCount)
 {
-    {
-        std::lock_guard<std::mutex> lk(_eventCvMutex);
-        _lastNotifiedEventType.insert_or_assign(eventType, changedCount);
-    }
-    _eventCv.notify_all();
+    _eventDispatcher.notify(eventType, changedCount);
+}
+
+void Robot::receiveIndexedValueNotification(const IndexedValueNotification & notification)
+{
+    receiveValue(toEventType(notification.method), notification.index, notification.value, notification.changedCount,
+            notification.receiveTime, notification.parseTime);
 }
 
 std::string Robot::motorIndexToStringHelper(MotorIndex motorIndex)
@@ -99,36 +549,321 @@ std::string Robot::motorIndexToStringHelper(MotorIndex motorIndex)
             + std::to_string(static_cast<int>(motorIndex)) + " into Robot::MotorIndex");
 }
 
-EventType Robot::waitChangedHelper(std::map<EventType, int> & eventTypes) {
-    std::unique_lock<std::mutex> lk(_eventCvMutex);
-    EventType notifiedEventType;
-    _eventCv.wait(lk, [eventTypes, &notifiedEventType, lastNotifiedEventType = std::ref(_lastNotifiedEventType)]{
-        for (auto eventType : eventTypes) {
-            auto itFind = lastNotifiedEventType.get().find(eventType.first);
-            if (   itFind != lastNotifiedEventType.get().end()
-                && itFind->second > eventType.second)
+void Robot::receiveValue(EventType eventType, std::size_t index, std::int64_t value, int changedCount,
+        std::chrono::steady_clock::time_point receiveTime, std::chrono::steady_clock::time_point parseTime)
+{
+    // A well formed update the robot server will send again after a reconnection, so dropped instead of
+    // thrown as a corrupt stream
+    if (!isSensorIndexValid(eventType, index))
+    {
+        _outOfRangeUpdateCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (_isLatencyInstrumented)
+    {
+        std::int64_t setTime = telemetryTimestamp();
+        recordLatency(eventType, LatencyStage::RECEIVE_TO_PARSE, toNanoseconds(parseTime) - toNanoseconds(receiveTime));
+        recordLatency(eventType, LatencyStage::PARSE_TO_SET, setTime - toNanoseconds(parseTime));
+        _lastReceiveTimes[static_cast<std::size_t>(eventType)].store(toNanoseconds(receiveTime), std::memory_order_relaxed);
+        _lastSetTimes[static_cast<std::size_t>(eventType)].store(setTime, std::memory_order_relaxed);
+    }
+
+    if (_isRecording)
+    {
+        TelemetryRecord telemetryRecord = {};
+        telemetryRecord.timestamp = telemetryTimestamp();
+        telemetryRecord.type = TelemetryRecord::Type::NOTIFICATION;
+        telemetryRecord.eventType = static_cast<std::uint8_t>(eventType);
+        telemetryRecord.index = static_cast<std::uint32_t>(index);
+        telemetryRecord.value = value;
+        telemetryRecord.changedCount = changedCount;
+        record(telemetryRecord);
+    }
+
+    int missedCount = 0;
+    switch (eventType)
+    {
+        case EventType::IR_PROXIMITYS_DISTANCE_DETECTED:
+            missedCount = _irProximitysDistanceDetected.set(index, value, changedCount, receiveTime);
+            break;
+        case EventType::LINE_TRACKS_IS_DETECTED:
+            missedCount = _lineTracksIsDetected.set(index, value != 0, changedCount, receiveTime);
+            break;
+        case EventType::LINE_TRACKS_VALUE:
+            missedCount = _lineTracksValue.set(index, value, changedCount, receiveTime);
+            break;
+        case EventType::ENCODER_WHEELS_VALUE:
+            missedCount = _encoderWheelsValue.set(index, value, changedCount, receiveTime);
+            break;
+        case EventType::SWITCHS_IS_DETECTED:
+            missedCount = _switchsIsDetected.set(index, value != 0, changedCount, receiveTime);
+            break;
+        case EventType::ULTRASOUNDS_DISTANCE_DETECTED:
+            missedCount = _ultrasoundsDistanceDetected.set(index, value, changedCount, receiveTime);
+            break;
+        case EventType::ODOMETRY_UPDATED:
+        case EventType::UPDATES_MISSED:
+        case EventType::LINE_POSITION_UPDATED:
+            // Computed by the robot, never received
+            return;
+    }
+    // Older than the current value, dropped
+    if (missedCount < 0)
+        return;
+    if (_isResuming.load(std::memory_order_relaxed) && _isResuming.exchange(false))
+        _lastResumeDuration = toNanoseconds(receiveTime) - _disconnectTime;
+    if (missedCount > 0)
+        missedUpdates(missedCount);
+    if (eventType == EventType::ENCODER_WHEELS_VALUE)
+        updateOdometry(index, value, receiveTime);
+    else if (eventType == EventType::LINE_TRACKS_VALUE)
+        updateLinePosition(index, value, receiveTime);
+    if (_hasSubscriptions)
+        publishUpdate(eventType, index, value, changedCount, receiveTime);
+}
+
+void Robot::missedUpdates(int missedCount)
+{
+    _missedUpdateCount.fetch_add(missedCount, std::memory_order_relaxed);
+    _eventDispatcher.notify(EventType::UPDATES_MISSED, ++_missedUpdateEventCount);
+    if (!_isResendOnMissedUpdates || !_jsonRpcTcpClient || _isResendPending.exchange(true))
+        return;
+    _jsonRpcTcpClient->callMethodAsync(RESEND_SENSORS_METHOD, Json::Value(), [this](const Json::Value &){
+        _isResendPending = false;
+    });
+}
+
+void Robot::connectionChanged(bool isConnected)
+{
+    if (!isConnected)
+    {
+        setIsReady(false);
+        _disconnectTime = telemetryTimestamp();
+        _isResuming = true;
+        return;
+    }
+    if (_jsonRpcTcpClient->reconnectCount() == 0)
+        return;
+
+    // The robot server may have restarted, with new changed counts and encoder values
+    _irProximitysDistanceDetected.resume();
+    _lineTracksIsDetected.resume();
+    _lineTracksValue.resume();
+    _encoderWheelsValue.resume();
+    _switchsIsDetected.resume();
+    _ultrasoundsDistanceDetected.resume();
+    _odometry.resetEncoders();
+    // The speeds must be measured again, and the powers sent again as the commands sent meanwhile are dropped
+    _wheelSpeedController.reset();
+}
+
+void Robot::setIsReady(bool isReady)
+{
+    {
+        std::lock_guard<std::mutex> lk(_isReadyMutex);
+        _isReady = isReady;
+    }
+    _isReadyCv.notify_all();
+}
+
+void Robot::publishUpdate(EventType eventType, std::size_t index, std::int64_t value, int changedCount,
+        std::chrono::steady_clock::time_point receiveTime)
+{
+    auto subscriptions = _subscriptions.load();
+    for (const auto & subscription : *subscriptions)
+        if (subscription->filter().accepts(eventType, index))
+            subscription->push({eventType, index, value, changedCount, receiveTime});
+}
+
+void Robot::updateLinePosition(std::size_t index, std::int64_t value, std::chrono::steady_clock::time_point receiveTime)
+{
+    if (!_lineTracker.update(index, static_cast<std::uint8_t>(value), receiveTime))
+        return;
+    if (_isLatencyInstrumented)
+    {
+        std::size_t eventIndex = static_cast<std::size_t>(EventType::LINE_POSITION_UPDATED);
+        _lastReceiveTimes[eventIndex].store(toNanoseconds(receiveTime), std::memory_order_relaxed);
+        _lastSetTimes[eventIndex].store(telemetryTimestamp(), std::memory_order_relaxed);
+    }
+    _eventDispatcher.notify(EventType::LINE_POSITION_UPDATED, _lineTracker.estimate().updateCount);
+}
+
+void Robot::updateOdometry(std::size_t index, std::int64_t value, std::chrono::steady_clock::time_point receiveTime)
+{
+    if (index >= _motorDirections.size())
+        return;
+    auto wheel = static_cast<Odometry::Wheel>(index);
+    bool isPoseUpdated = _odometry.update(wheel, value, _motorDirections[index].load(std::memory_order_relaxed), receiveTime);
+    // Before waking up the waiting threads, the motors command is the most urgent
+    _wheelSpeedController.update(wheel, _odometry.wheelDistance(wheel), receiveTime);
+    if (!isPoseUpdated)
+        return;
+    if (_isLatencyInstrumented)
+    {
+        std::size_t eventIndex = static_cast<std::size_t>(EventType::ODOMETRY_UPDATED);
+        _lastReceiveTimes[eventIndex].store(toNanoseconds(receiveTime), std::memory_order_relaxed);
+        _lastSetTimes[eventIndex].store(telemetryTimestamp(), std::memory_order_relaxed);
+    }
+    _eventDispatcher.notify(EventType::ODOMETRY_UPDATED, _odometry.pose().updateCount);
+}
+
+void Robot::sendMotorsPower(std::optional<float> rightValue, std::optional<float> leftValue)
+{
+    if (rightValue.has_value() && rightValue.value() != 0.0f)
+        _motorDirections[static_cast<std::size_t>(MotorIndex::RIGHT)] = rightValue.value() > 0.0f ? 1 : -1;
+    if (leftValue.has_value() && leftValue.value() != 0.0f)
+        _motorDirections[static_cast<std::size_t>(MotorIndex::LEFT)] = leftValue.value() > 0.0f ? 1 : -1;
+
+    if (_isRecording)
+    {
+        TelemetryRecord telemetryRecord = {};
+        telemetryRecord.timestamp = telemetryTimestamp();
+        telemetryRecord.type = TelemetryRecord::Type::MOTORS_COMMAND;
+        telemetryRecord.motorsMask = (rightValue.has_value() ? TelemetryRecord::RIGHT_MOTOR : 0)
+                | (leftValue.has_value() ? TelemetryRecord::LEFT_MOTOR : 0);
+        telemetryRecord.rightValue = rightValue.value_or(0.0f);
+        telemetryRecord.leftValue = leftValue.value_or(0.0f);
+        record(telemetryRecord);
+    }
+
+    // When replaying a telemetry log
+    if (!_jsonRpcTcpClient)
+        return;
+
+    // Fixed shape notifications, formatted without Json::Value
+    if (rightValue.has_value() && leftValue.has_value())
+        _jsonRpcTcpClient->callNotification("setMotorsPower", {{"rightValue", rightValue.value()}, {"leftValue", leftValue.value()}});
+    else
+    {
+        MotorIndex motorIndex = rightValue.has_value() ? MotorIndex::RIGHT : MotorIndex::LEFT;
+        _jsonRpcTcpClient->callNotification("setMotorPower", {{"motorIndex", motorIndexToStringHelper(motorIndex)},
+                {"value", rightValue.has_value() ? rightValue.value() : leftValue.value()}});
+    }
+
+    if (_isLatencyInstrumented)
+    {
+        std::int64_t writeTime = telemetryTimestamp();
+        std::lock_guard<std::mutex> lk(_motorsCommandCauseMutex);
+        if (_motorsCommandCauseEventType.has_value())
+        {
+            EventType eventType = _motorsCommandCauseEventType.value();
+            recordLatency(eventType, LatencyStage::WAKEUP_TO_WRITE, writeTime - _motorsCommandCauseWakeUpTime);
+            recordLatency(eventType, LatencyStage::RECEIVE_TO_WRITE, writeTime - _motorsCommandCauseReceiveTime);
+            _motorsCommandCauseEventType.reset();
+        }
+    }
+}
+
+void Robot::takeMotorsCommandCause()
+{
+    if (!_isLatencyInstrumented || lastWakeUp.robot != this)
+        return;
+    {
+        std::lock_guard<std::mutex> lk(_motorsCommandCauseMutex);
+        _motorsCommandCauseEventType = lastWakeUp.eventType;
+        _motorsCommandCauseReceiveTime = lastWakeUp.receiveTime;
+        _motorsCommandCauseWakeUpTime = lastWakeUp.wakeUpTime;
+    }
+    // Only the first command after a wake up is caused by it
+    lastWakeUp.robot = nullptr;
+}
+
+void Robot::wokenUp(EventType eventType)
+{
+    if (!_isLatencyInstrumented)
+        return;
+    std::int64_t wakeUpTime = telemetryTimestamp();
+    std::size_t eventIndex = static_cast<std::size_t>(eventType);
+    recordLatency(eventType, LatencyStage::SET_TO_WAKEUP, wakeUpTime - _lastSetTimes[eventIndex].load(std::memory_order_relaxed));
+    lastWakeUp = {this, eventType, _lastReceiveTimes[eventIndex].load(std::memory_order_relaxed), wakeUpTime};
+}
+
+void Robot::recordLatency(EventType eventType, LatencyStage latencyStage, std::int64_t latency)
+{
+    (*_latencyHistograms)[static_cast<std::size_t>(eventType)][static_cast<std::size_t>(latencyStage)]
+            .record(std::chrono::nanoseconds(latency));
+}
+
+void Robot::record(const TelemetryRecord & telemetryRecord)
+{
+    std::lock_guard<std::mutex> lk(_telemetryRecorderMutex);
+    if (_telemetryRecorder)
+        _telemetryRecorder->record(telemetryRecord);
+}
+
+void Robot::replay(ReplaySpeed replaySpeed)
+{
+    setIsReady(true);
+    auto replayTime = std::chrono::steady_clock::now();
+    std::optional<std::int64_t> lastTimestamp;
+    for (const TelemetryRecord & telemetryRecord : *_telemetryLog)
+    {
+        if (_isReplayStopping)
+            return;
+        if (telemetryRecord.type != TelemetryRecord::Type::NOTIFICATION)
+            continue;
+        // From a file, so anything can be there
+        EventType eventType = static_cast<EventType>(telemetryRecord.eventType);
+        if (telemetryRecord.eventType >= EVENT_TYPE_COUNT || !isSensorIndexValid(eventType, telemetryRecord.index))
+        {
+            _invalidReplayRecordCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (lastTimestamp.has_value())
+        {
+            // Unsigned, as a corrupt timestamp can overflow the difference
+            std::uint64_t gap = static_cast<std::uint64_t>(telemetryRecord.timestamp) - static_cast<std::uint64_t>(lastTimestamp.value());
+            if (telemetryRecord.timestamp < lastTimestamp.value() || gap > static_cast<std::uint64_t>(MAX_REPLAY_GAP.count()))
             {
-                itFind->second = eventType.second;
-                notifiedEventType = eventType.first;
-                return true;
+                _invalidReplayRecordCount.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (replaySpeed == ReplaySpeed::REAL_TIME)
+            {
+                // Woken up by the destructor
+                replayTime += std::chrono::nanoseconds(gap);
+                std::unique_lock<std::mutex> lk(_replayMutex);
+                if (_replayCv.wait_until(lk, replayTime, [this]{return _isReplayStopping.load();}))
+                    return;
             }
         }
-        return false;
-    });
-    return notifiedEventType;
+        lastTimestamp = telemetryRecord.timestamp;
+        auto now = std::chrono::steady_clock::now();
+        try
+        {
+            receiveValue(eventType, telemetryRecord.index, telemetryRecord.value, telemetryRecord.changedCount, now, now);
+        }
+        catch (const std::exception & exception)
+        {
+            // Nobody to catch it in the replay thread, skip this record as an invalid one
+            std::cerr << "Telemetry log replay error: " << exception.what() << std::endl;
+            _invalidReplayRecordCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    _isReplayEnded = true;
 }
 
-std::map<EventType, int> Robot::waitParamHelper(std::set<EventType> eventTypes)
+bool Robot::isSensorIndexValid(EventType eventType, std::size_t index)
 {
-    std::map<EventType, int> toReturn;
-    std::unique_lock<std::mutex> lk(_eventCvMutex);
-    for (auto eventType : eventTypes)
+    switch (eventType)
     {
-        int changedCount = -1;
-        auto it = _lastNotifiedEventType.find(eventType);
-        if (it != _lastNotifiedEventType.end())
-            changedCount = it->second;
-        toReturn.insert(std::make_pair(eventType, changedCount));
+        case EventType::IR_PROXIMITYS_DISTANCE_DETECTED:
+            return index < IrProximitysDistanceDetected::INDEX_CAPACITY;
+        case EventType::LINE_TRACKS_IS_DETECTED:
+            return index < LineTracksIsDetected::INDEX_CAPACITY;
+        case EventType::LINE_TRACKS_VALUE:
+            return index < LineTracksValue::INDEX_CAPACITY;
+        case EventType::ENCODER_WHEELS_VALUE:
+            return index < EncoderWheelsValue::INDEX_CAPACITY;
+        case EventType::SWITCHS_IS_DETECTED:
+            return index < SwitchsIsDetected::INDEX_CAPACITY;
+        case EventType::ULTRASOUNDS_DISTANCE_DETECTED:
+            return index < UltrasoundsDistanceDetected::INDEX_CAPACITY;
+        case EventType::ODOMETRY_UPDATED:
+        case EventType::UPDATES_MISSED:
+        case EventType::LINE_POSITION_UPDATED:
+            break;
     }
-    return toReturn;
+    return false;
 }
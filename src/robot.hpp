@@ -3,13 +3,30 @@
 
 #include "jsonrpctcpclient.hpp"
 #include "values.hpp"
+#include "eventdispatcher.hpp"
+#include "motorscommandwriter.hpp"
+#include "telemetrylog.hpp"
+#include "latencyhistogram.hpp"
+#include "odometry.hpp"
+#include "linetracker.hpp"
+#include "wheelspeedcontroller.hpp"
+#include "sensorsubscription.hpp"
+
+#include <asio/any_io_executor.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/io_context.hpp>
 
 #include <string>
 #include <optional>
-#include <semaphore>
-#include <condition_variable>
 #include <set>
 #include <chrono>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <array>
+#include <condition_variable>
+#include <ostream>
 
 enum class EventType
 {
@@ -18,21 +35,87 @@ enum class EventType
     LINE_TRACKS_VALUE, //!< A new value of the raw line color have been received
     ENCODER_WHEELS_VALUE, //!< A new value of the encoder wheels have been received
     SWITCHS_IS_DETECTED, //!< A new value of the switch have been received
-    ULTRASOUNDS_DISTANCE_DETECTED //!< A new value of ultrasound distance have been received
+    ULTRASOUNDS_DISTANCE_DETECTED, //!< A new value of ultrasound distance have been received
+    ODOMETRY_UPDATED, //!< The pose has been updated from a new value of the encoder wheels
+    UPDATES_MISSED, //!< A sensor value has been received after some updates of its index have been missed
+    LINE_POSITION_UPDATED //!< The line position has been updated from a new raw line color
+};
+constexpr std::size_t EVENT_TYPE_COUNT = static_cast<std::size_t>(EventType::LINE_POSITION_UPDATED) + 1;
+
+//! @brief Steps measured between a sensor message received and the motors command it causes.
+enum class LatencyStage
+{
+    RECEIVE_TO_PARSE, //!< From the message read from the socket to the end of its parse
+    PARSE_TO_SET, //!< From the end of the parse to the value stored
+    SET_TO_WAKEUP, //!< From the value stored to a thread waiting for this event woken up
+    WAKEUP_TO_WRITE, //!< From the wake up to the write of the next motors command of this thread
+    RECEIVE_TO_WRITE //!< From the message read from the socket to the write of the motors command
 };
+constexpr std::size_t LATENCY_STAGE_COUNT = static_cast<std::size_t>(LatencyStage::RECEIVE_TO_WRITE) + 1;
 
-class Robot : public IRobot<EventType>
+class Robot : public IRobot<EventType>, private IndexedValueNotificationReceiver
 {
 public:
+    using IrProximitysDistanceDetected = Values<std::size_t, EventType, EventType::IR_PROXIMITYS_DISTANCE_DETECTED>;
+    using LineTracksIsDetected = Values<bool, EventType, EventType::LINE_TRACKS_IS_DETECTED>;
+    using LineTracksValue = Values<std::uint8_t, EventType, EventType::LINE_TRACKS_VALUE>;
+    using EncoderWheelsValue = Values<std::size_t, EventType, EventType::ENCODER_WHEELS_VALUE>;
+    using SwitchsIsDetected = Values<bool, EventType, EventType::SWITCHS_IS_DETECTED>;
+    using UltrasoundsDistanceDetected = Values<std::size_t, EventType, EventType::ULTRASOUNDS_DISTANCE_DETECTED>;
+    using Subscription = SensorSubscription<EventType, EVENT_TYPE_COUNT>;
+
+    //! @brief Consistent copy of the last values of all the sensors.
+    struct Snapshot
+    {
+        IrProximitysDistanceDetected::Snapshot irProximitysDistanceDetected;
+        LineTracksIsDetected::Snapshot lineTracksIsDetected;
+        LineTracksValue::Snapshot lineTracksValue;
+        EncoderWheelsValue::Snapshot encoderWheelsValue;
+        SwitchsIsDetected::Snapshot switchsIsDetected;
+        UltrasoundsDistanceDetected::Snapshot ultrasoundsDistanceDetected;
+        Odometry::Pose pose;
+        LineTracker::Estimate linePosition;
+    };
+
     //! @brief Create a new robot connexion with a robot server (simu or reel).
     Robot(const std::string & hostIpAddress, uint16_t tcpPort);
 
+    //! @brief Create a new robot connexion without any dedicated thread: the notifications are
+    //! received and the motors commands sent from the threads running ioContext.
+    //! @warning ioContext must be run until this robot is destroyed, from other threads than the one
+    //! destroying it.
+    Robot(asio::io_context & ioContext, const std::string & hostIpAddress, uint16_t tcpPort);
+
+    //! @brief Create a robot replaying a telemetry log instead of connecting to a robot server.
+    //! The recorded notifications are received as if sent by a robot server, the motors commands
+    //! are not sent anywhere (but can be recorded).
+    enum class ReplaySpeed {REAL_TIME, AS_FAST_AS_POSSIBLE};
+    Robot(const std::string & telemetryLogPath, ReplaySpeed replaySpeed);
+
     //! @brief Close the robot connexion.
     virtual ~Robot();
 
+    //! @brief Ask the robot server to send the sensor notifications with this encoding.
+    //! @return The encoding used from now, JSON if the robot server does not support the requested one
+    //! or if this robot replays a telemetry log.
+    WireEncoding negotiateWireEncoding(WireEncoding wireEncoding)
+            {return _jsonRpcTcpClient ? _jsonRpcTcpClient->negotiateWireEncoding(wireEncoding) : WireEncoding::JSON;}
+
     //! @brief Wait for the robot server to be ready to send or receive messages.
-    inline void waitReady() {using namespace std::chrono_literals; _isReadySemaphore.acquire();
-            std::this_thread::sleep_for(100ms);}
+    //! Return at once if it is already ready, and wait again after a connexion loss until the new
+    //! connexion is ready.
+    void waitReady();
+
+    //! @name Connexion to the robot server, made again automatically when it is lost
+    //! The sensor values are kept across the connexions, the motors commands sent meanwhile are dropped.
+    //! \{
+    bool isConnected() const {return _jsonRpcTcpClient && _jsonRpcTcpClient->isConnected();}
+    //! @return The number of connexions made again after a loss.
+    std::uint64_t getReconnectCount() const {return _jsonRpcTcpClient ? _jsonRpcTcpClient->reconnectCount() : 0;}
+    //! @return The duration from the last connexion loss to the first sensor update received on the
+    //! next connexion, none if no connexion has been resumed yet.
+    std::optional<std::chrono::nanoseconds> getLastResumeDuration() const;
+    //! \}
 
     //! @return The last IR distance receive from robot server (in pixel on simu).
     //! @param index The index of this sensor ont he robot starting from 0.
@@ -58,7 +141,103 @@ public:
     //! @param index The index of this sensor ont he robot starting from 0.
     std::size_t getUltrasoundsDistanceDetected(std::size_t index) const {return _ultrasoundsDistanceDetected.get(index);}
 
+    //! @return The last samples received from robot server, with their receive time.
+    //! @param index The index of this sensor ont he robot starting from 0.
+    //! \{
+    const IrProximitysDistanceDetected::History & getIrProximitysDistanceDetectedHistory(std::size_t index) const {return _irProximitysDistanceDetected.history(index);}
+    const LineTracksIsDetected::History & getLineTracksIsDetectedHistory(std::size_t index) const {return _lineTracksIsDetected.history(index);}
+    const LineTracksValue::History & getLineTracksValueHistory(std::size_t index) const {return _lineTracksValue.history(index);}
+    const EncoderWheelsValue::History & getEncoderWheelValueHistory(std::size_t index) const {return _encoderWheelsValue.history(index);}
+    const SwitchsIsDetected::History & getSwitchsIsDetectedHistory(std::size_t index) const {return _switchsIsDetected.history(index);}
+    const UltrasoundsDistanceDetected::History & getUltrasoundsDistanceDetectedHistory(std::size_t index) const {return _ultrasoundsDistanceDetected.history(index);}
+    //! \}
+
+    //! @return A consistent copy of the last values of all the sensors, without blocking the reception.
+    Snapshot snapshot() const;
+
+    //! @brief Set the geometry of the line track sensors bar used to estimate the line position.
+    void setLineTrackerConfig(const LineTracker::Config & config) {_lineTracker.setConfig(config);}
+
+    //! @brief Calibrate the raw line colors of each sensor with the range received until stopLineCalibration.
+    void startLineCalibration() {_lineTracker.startCalibration();}
+    void stopLineCalibration() {_lineTracker.stopCalibration();}
+
+    //! @return The last line position estimated from the raw line colors, without blocking the reception.
+    LineTracker::Estimate getLinePosition() const {return _lineTracker.estimate();}
+
+    //! @return The last calibrated line reading of this sensor, in [0, 1].
+    float getLineTrackReading(std::size_t index) const {return _lineTracker.reading(index);}
+
+    //! @name Sequence tracking of the sensor values, from the changed count of each index
+    //! Each index of each sensor increments its changed count by one at each update, so a greater step
+    //! means the robot server or the network has dropped updates, and a smaller one a reordered update.
+    //! \{
+    //! @return The number of sensor updates missed since the connexion, on all the sensors.
+    std::uint64_t getMissedUpdateCount() const {return _missedUpdateCount;}
+    //! @return The number of sensor updates missed on this index of this sensor event.
+    std::uint64_t getMissedUpdateCount(EventType eventType, std::size_t index) const;
+    //! @return The number of sensor updates received after a newer one on this index, they are dropped.
+    std::uint64_t getStaleUpdateCount(EventType eventType, std::size_t index) const;
+    //! @return The number of sensor updates dropped because their index is beyond the capacity of their sensor.
+    std::uint64_t getOutOfRangeUpdateCount() const {return _outOfRangeUpdateCount;}
+    //! @brief Ask the robot server to send again the value of all its sensors each time updates are
+    //! missed (disabled by default), with the method RESEND_SENSORS_METHOD.
+    void setResendOnMissedUpdates(bool isResendOnMissedUpdates) {_isResendOnMissedUpdates = isResendOnMissedUpdates;}
+    static constexpr const char * RESEND_SENSORS_METHOD = "resendSensors";
+    //! \}
+
+    //! @brief Read the current value of every sensor from the robot server in one round trip, with one
+    //! JSON-RPC batch of SENSOR_VALUES_METHOD calls (one per sensor family), and store them as updates.
+    //! Useful at start and after a connexion loss, instead of waiting for each sensor to be notified.
+    //! @throw std::runtime_error If the robot server answers an error for a sensor family, the other
+    //! families are stored anyway, or if it has not answered before the call timeout.
+    void fetchSensors();
+    //! Params {"method":notificationMethodName}, result [{"index":i,"value":v,"changedCount":c},...]
+    static constexpr const char * SENSOR_VALUES_METHOD = "getSensorValues";
+
+    //! @brief Queue every update of the sensor events and indexes of filter, in their receive order,
+    //! to be read with Subscription::poll or Subscription::wait.
+    //! @warning The reception waits while the queue is full, so it must be drained until unsubscribe.
+    std::shared_ptr<Subscription> subscribe(const Subscription::Filter & filter, const Subscription::Config & config = {});
+
+    //! @brief Call callback from a dedicated thread with batches of every update of the sensor events
+    //! and indexes of filter, in their receive order, as soon as they are received.
+    std::shared_ptr<Subscription> subscribe(const Subscription::Filter & filter, const Subscription::Callback & callback,
+            const Subscription::Config & config = {});
+
+    //! @brief Stop queueing updates into this subscription, its dispatcher thread ends once the already
+    //! queued updates have been delivered.
+    void unsubscribe(const std::shared_ptr<Subscription> & subscription);
+
+    //! @brief Set the geometry of the robot used to integrate its pose from the encoder wheels.
+    //! The default one is the simu robot: wheel base of 50 pixels and 2 ticks per pixel.
+    void setOdometryConfig(const Odometry::Config & config) {_odometry.setConfig(config);}
+
+    //! @brief Set the current pose (in unit and radian), ODOMETRY_UPDATED is notified.
+    void resetPose(double x, double y, double theta);
+
+    //! @return The last pose integrated from the encoder wheels, without blocking the reception.
+    Odometry::Pose getPose() const {return _odometry.pose();}
+
+    //! @name Closed loop wheel speeds
+    //! A PID per wheel runs in the receive path at each encoder wheel value, without any other thread,
+    //! and sends a motors command only when the power of a wheel changes. The default config is for
+    //! the simu robot.
+    //! \{
+    void setWheelSpeedControllerConfig(const WheelSpeedController::Config & config) {_wheelSpeedController.setConfig(config);}
+    //! @brief Control the wheels to these speeds, in unit per second (positive forward) of the odometry
+    //! config, until setMotorPower or setMotorsPower is called.
+    void setWheelSpeeds(double rightSpeed, double leftSpeed) {_wheelSpeedController.setTargetSpeeds(rightSpeed, leftSpeed);}
+    //! @brief Stop the control, the motors keep their last power.
+    void stopWheelSpeedControl() {_wheelSpeedController.disable();}
+    WheelSpeedController::TrackingStatistics getWheelSpeedTracking(Odometry::Wheel wheel) const
+            {return _wheelSpeedController.trackingStatistics(wheel);}
+    void resetWheelSpeedTracking() {_wheelSpeedController.resetTrackingStatistics();}
+    //! \}
+
     //! @brief Set current motor(s) power(s).
+    //! The command is sent by a dedicated thread, so this never blocks on the socket. A command not
+    //! sent yet is replaced by the next one. Stop the wheel speed control if any.
     //! @param value PWM between -1.0 and 1.0.
     //! \{
     enum class MotorIndex {RIGHT = 0, LEFT = 1};
@@ -66,6 +245,39 @@ public:
     void setMotorsPower(float rightValue, float leftValue);
     //! \}
 
+    //! @brief Set the minimum duration between two motors commands sent to the robot server.
+    //! Zero (the default) send a command as soon as the previous one has been written.
+    template<typename _Rep, typename _Period>
+    void setMotorsCommandPeriod(const std::chrono::duration<_Rep, _Period> & period)
+            {_motorsCommandWriter.setPeriod(std::chrono::duration_cast<std::chrono::nanoseconds>(period));}
+
+    //! @brief Record every received notification and sent motors command into a telemetry log.
+    //! Replace the current recording if any.
+    void startRecording(const std::string & telemetryLogPath);
+    void stopRecording();
+
+    //! @return True if this robot replays a telemetry log and all its notifications have been received.
+    bool isReplayEnded() const {return _isReplayEnded;}
+
+    //! @return The number of telemetry log notifications skipped by the replay, for an unknown sensor or
+    //! index, or a timestamp going back or jumping ahead.
+    std::uint64_t getInvalidReplayRecordCount() const {return _invalidReplayRecordCount;}
+
+    //! @brief Enable or disable (the default) the latency measure of each LatencyStage.
+    void setLatencyInstrumented(bool isLatencyInstrumented) {_isLatencyInstrumented = isLatencyInstrumented;}
+
+    //! @return The latencies measured for this event at this stage, can be read while updated.
+    const LatencyHistogram & getLatencyHistogram(EventType eventType, LatencyStage latencyStage) const
+            {return (*_latencyHistograms)[static_cast<std::size_t>(eventType)][static_cast<std::size_t>(latencyStage)];}
+    void resetLatencyHistograms();
+
+    //! @brief Print count, p50, p99 and max of each latency histogram, one per line.
+    void dumpLatencyHistograms(std::ostream & os) const;
+
+    //! @brief Dump the latency histograms from a dedicated thread at each period.
+    void startLatencyDump(std::chrono::milliseconds period, std::ostream & os);
+    void stopLatencyDump();
+
     //! @brief Wait until this specific event has been received
     void waitChanged(EventType eventType);
 
@@ -83,63 +295,144 @@ public:
     template<typename _Rep, typename _Period>
     std::optional<EventType> waitChanged(const std::set<EventType> & eventTypes, const std::chrono::duration<_Rep, _Period> & duration);
 
+    //! @brief Wait from a coroutine until one of the listed event has been received, without blocking its thread.
+    //! The coroutine is resumed on its own executor, so many of them can share one thread.
+    //! @return The received event
+    //! @throw std::runtime_error If the robot is destroyed meanwhile.
+    asio::awaitable<EventType> changed(std::set<EventType> eventTypes);
+
+    //! @brief Wait from a coroutine until one of the listed event has been received or timeout.
+    //! @return The received event if a event of the list has been received or an empty value if timeout,
+    //! or if the robot is destroyed meanwhile
+    template<typename _Rep, typename _Period>
+    asio::awaitable<std::optional<EventType>> changed(std::set<EventType> eventTypes, std::chrono::duration<_Rep, _Period> duration)
+            {return changedFor(std::move(eventTypes), std::chrono::ceil<std::chrono::steady_clock::duration>(duration));}
+
+    //! @brief Context on which the coroutines using this robot can run, it is not run by the robot.
+    asio::io_context & ioContext() {return _jsonRpcTcpClient ? _jsonRpcTcpClient->ioContext() : *_replayIoContext;}
+
 private:
     Robot(const Robot &) = delete;
     Robot & operator=(const Robot &) = delete;
 
+    Robot(std::unique_ptr<JsonRpcTcpClient> jsonRpcTcpClient, std::optional<asio::any_io_executor> writerExecutor);
+
+    void bindNotificationsAndStartReceive();
+
     void notify(EventType eventType, int changedCount) override;
+    void receiveIndexedValueNotification(const IndexedValueNotification & notification) override;
 
     static std::string motorIndexToStringHelper(MotorIndex motorIndex);
-    EventType waitChangedHelper(std::map<EventType, int> & eventTypes);
-    template<typename _Rep, typename _Period>
-    std::optional<EventType> waitChangedHelper(std::map<EventType, int> & eventTypes, const std::chrono::duration<_Rep, _Period> & duration);
-    std::map<EventType, int> waitParamHelper(std::set<EventType> eventTypes);
-
-    JsonRpcTcpClient _jsonRpcTcpClient;
-    Values<std::size_t, EventType, EventType::IR_PROXIMITYS_DISTANCE_DETECTED> _irProximitysDistanceDetected;
-    Values<bool, EventType, EventType::LINE_TRACKS_IS_DETECTED> _lineTracksIsDetected;
-    Values<std::uint8_t, EventType, EventType::LINE_TRACKS_VALUE> _lineTracksValue;
-    Values<std::size_t, EventType, EventType::ENCODER_WHEELS_VALUE> _encoderWheelsValue;
-    Values<bool, EventType, EventType::SWITCHS_IS_DETECTED> _switchsIsDetected;
-    Values<std::size_t, EventType, EventType::ULTRASOUNDS_DISTANCE_DETECTED> _ultrasoundsDistanceDetected;
-    std::binary_semaphore _isReadySemaphore;
-    std::mutex _eventCvMutex;
-    std::condition_variable _eventCv;
-    std::map<EventType, int> _lastNotifiedEventType;
+    void receiveValue(EventType eventType, std::size_t index, std::int64_t value, int changedCount,
+            std::chrono::steady_clock::time_point receiveTime, std::chrono::steady_clock::time_point parseTime);
+    void publishUpdate(EventType eventType, std::size_t index, std::int64_t value, int changedCount,
+            std::chrono::steady_clock::time_point receiveTime);
+    void missedUpdates(int missedCount);
+    //! @return True if this event type is a received sensor value and this index is within its capacity.
+    static bool isSensorIndexValid(EventType eventType, std::size_t index);
+    void connectionChanged(bool isConnected);
+    void setIsReady(bool isReady);
+    void updateLinePosition(std::size_t index, std::int64_t value, std::chrono::steady_clock::time_point receiveTime);
+    void updateOdometry(std::size_t index, std::int64_t value, std::chrono::steady_clock::time_point receiveTime);
+    void wokenUp(EventType eventType);
+    //! @brief Charge the next motors command to the last wake up of the calling thread, if not charged yet.
+    void takeMotorsCommandCause();
+    asio::awaitable<std::optional<EventType>> changedFor(std::set<EventType> eventTypes,
+            std::optional<std::chrono::steady_clock::duration> duration);
+    using ChangedCompletion = std::function<void(std::optional<EventType> notifiedEventType)>;
+    void asyncWaitChanged(const std::set<EventType> & eventTypes, std::optional<std::chrono::steady_clock::duration> duration,
+            const asio::any_io_executor & executor, ChangedCompletion completion);
+    void recordLatency(EventType eventType, LatencyStage latencyStage, std::int64_t latency);
+
+    //! @brief Event dispatcher of the async wait handlers, which can run after the robot destruction on a
+    //! shared io_context: null once the robot is destroyed.
+    struct AsyncWaitGuard
+    {
+        AsyncWaitGuard(EventDispatcher<EventType, EVENT_TYPE_COUNT> * eventDispatcherParam) : mutex(), eventDispatcher(eventDispatcherParam) {}
+        std::mutex mutex;
+        EventDispatcher<EventType, EVENT_TYPE_COUNT> * eventDispatcher;
+    };
+    void sendMotorsPower(std::optional<float> rightValue, std::optional<float> leftValue);
+    void record(const TelemetryRecord & record);
+    void replay(ReplaySpeed replaySpeed);
+
+    SeqLock _sensorsSeqLock;
+    IrProximitysDistanceDetected _irProximitysDistanceDetected;
+    LineTracksIsDetected _lineTracksIsDetected;
+    LineTracksValue _lineTracksValue;
+    EncoderWheelsValue _encoderWheelsValue;
+    SwitchsIsDetected _switchsIsDetected;
+    UltrasoundsDistanceDetected _ultrasoundsDistanceDetected;
+    Odometry _odometry;
+    //! Sign of the last non zero power sent to each motor, as the encoder wheels count an absolute distance
+    std::array<std::atomic<int>, 2> _motorDirections;
+    LineTracker _lineTracker;
+    WheelSpeedController _wheelSpeedController;
+    using Subscriptions = std::vector<std::shared_ptr<Subscription>>;
+    std::mutex _subscriptionsMutex; //!< Serialize the changes of _subscriptions, the reception never takes it
+    std::atomic<std::shared_ptr<const Subscriptions>> _subscriptions; //!< Replaced at each change
+    std::atomic<bool> _hasSubscriptions;
+    std::atomic<std::uint64_t> _missedUpdateCount;
+    std::atomic<int> _missedUpdateEventCount; //!< Changed count of UPDATES_MISSED
+    std::atomic<std::uint64_t> _outOfRangeUpdateCount;
+    std::atomic<bool> _isResendOnMissedUpdates;
+    std::atomic<bool> _isResendPending; //!< Only one resend at a time
+    std::mutex _isReadyMutex;
+    std::condition_variable _isReadyCv;
+    bool _isReady;
+    std::atomic<bool> _isResuming; //!< True from a connexion loss to the first sensor update of the next connexion
+    std::atomic<std::int64_t> _disconnectTime;
+    std::atomic<std::int64_t> _lastResumeDuration; //!< Negative until a connexion is resumed
+    EventDispatcher<EventType, EVENT_TYPE_COUNT> _eventDispatcher;
+    std::shared_ptr<AsyncWaitGuard> _asyncWaitGuard;
+    std::atomic<bool> _isRecording;
+    std::mutex _telemetryRecorderMutex;
+    std::unique_ptr<TelemetryRecorder> _telemetryRecorder;
+    std::unique_ptr<TelemetryLog> _telemetryLog;
+    std::atomic<bool> _isReplayStopping;
+    std::mutex _replayMutex;
+    std::condition_variable _replayCv; //!< Wake up the replay waiting for the time of the next record
+    std::atomic<bool> _isReplayEnded;
+    std::atomic<std::uint64_t> _invalidReplayRecordCount;
+    std::thread _replayThread;
+    std::unique_ptr<asio::io_context> _replayIoContext; //!< Only when replaying a telemetry log
+    std::atomic<bool> _isLatencyInstrumented;
+    using LatencyHistograms = std::array<std::array<LatencyHistogram, LATENCY_STAGE_COUNT>, EVENT_TYPE_COUNT>;
+    std::unique_ptr<LatencyHistograms> _latencyHistograms;
+    std::array<std::atomic<std::int64_t>, EVENT_TYPE_COUNT> _lastReceiveTimes; //!< Nanoseconds of the steady clock
+    std::array<std::atomic<std::int64_t>, EVENT_TYPE_COUNT> _lastSetTimes; //!< Nanoseconds of the steady clock
+    std::mutex _motorsCommandCauseMutex;
+    std::optional<EventType> _motorsCommandCauseEventType; //!< Event which has woken up the thread of the pending motors command
+    std::int64_t _motorsCommandCauseReceiveTime;
+    std::int64_t _motorsCommandCauseWakeUpTime;
+    std::mutex _latencyDumpMutex;
+    std::condition_variable _latencyDumpCv;
+    bool _isLatencyDumpStopping;
+    std::thread _latencyDumpThread;
+    // Destroyed before the values: the writer first, sending its last powers through the client, then
+    // the client, stopping the reception. The wheel speed control is disabled before, as it uses the writer.
+    std::unique_ptr<JsonRpcTcpClient> _jsonRpcTcpClient; //!< Null when replaying a telemetry log
+    MotorsCommandWriter _motorsCommandWriter;
 };
 
 
 template<typename _Rep, typename _Period>
 bool Robot::waitChanged(EventType eventType, const std::chrono::duration<_Rep, _Period> & duration)
 {
-    auto eventTypes = waitParamHelper({eventType});
-    return waitChangedHelper(eventTypes, duration).has_value();
+    auto eventTypes = _eventDispatcher.waitParam({eventType});
+    if (!_eventDispatcher.wait(eventTypes, duration).has_value())
+        return false;
+    wokenUp(eventType);
+    return true;
 }
 
 template<typename _Rep, typename _Period>
 std::optional<EventType> Robot::waitChanged(const std::set<EventType> & eventTypes, const std::chrono::duration<_Rep, _Period> & duration)
 {
-    auto eventTypesWithChangedCount = waitParamHelper(eventTypes);
-    return waitChangedHelper(eventTypesWithChangedCount, duration);
-}
-
-template<typename _Rep, typename _Period>
-std::optional<EventType> Robot::waitChangedHelper(std::map<EventType, int> & eventTypes, const std::chrono::duration<_Rep, _Period> & duration)
-{
-    std::unique_lock<std::mutex> lk(_eventCvMutex);
-    EventType notifiedEventType;
-    if (!_eventCv.wait_for(lk, duration, [eventTypes, &notifiedEventType, lastNotifiedEventType = std::ref(_lastNotifiedEventType)]{
-        for (auto eventType : eventTypes) {
-            if (lastNotifiedEventType.get().at(eventType.first)>eventType.second)
-            {
-                lastNotifiedEventType.get().at(eventType.first) = eventType.second;
-                notifiedEventType = eventType.first;
-                return true;
-            }
-        }
-        return false;
-    }))
-        return {};
+    auto eventTypesWithChangedCount = _eventDispatcher.waitParam(eventTypes);
+    auto notifiedEventType = _eventDispatcher.wait(eventTypesWithChangedCount, duration);
+    if (notifiedEventType.has_value())
+        wokenUp(notifiedEventType.value());
     return notifiedEventType;
 }
 
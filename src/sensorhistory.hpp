@@ -0,0 +1,146 @@
+#ifndef SENSORHISTORY_HPP
+#define SENSORHISTORY_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+
+
+//! @brief Last received samples of one sensor index, in a fixed capacity ring buffer.
+//! Readers copy the samples without any lock or allocation, and drop the ones overwritten by the
+//! writer during the copy, so they never block the thread calling push.
+//! @warning Only one thread at a time can call push.
+template<typename T, std::size_t CAPACITY>
+class SensorHistory
+{
+public:
+    struct Sample
+    {
+        T value;
+        int changedCount;
+        std::chrono::steady_clock::time_point receiveTime;
+    };
+
+    struct Statistics
+    {
+        std::size_t count; //!< Number of samples used, all other fields are zero if no sample
+        double mean;
+        T min;
+        T max;
+        double rateOfChange; //!< Value change per second between the oldest and the newest sample
+    };
+
+    SensorHistory() : _slots(), _pushCount(0) {}
+
+    void push(T value, int changedCount, std::chrono::steady_clock::time_point receiveTime)
+    {
+        std::uint64_t pushCount = _pushCount.load(std::memory_order_relaxed);
+        // As SeqLock::writeBegin: a reader seeing any slot store below also sees the push count of the
+        // previous push, at least, when it reloads the push count after its copy
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot & slot = _slots[pushCount%CAPACITY];
+        slot._value.store(value, std::memory_order_relaxed);
+        slot._changedCount.store(changedCount, std::memory_order_relaxed);
+        slot._receiveTime.store(receiveTime.time_since_epoch().count(), std::memory_order_relaxed);
+        _pushCount.store(pushCount + 1, std::memory_order_release);
+    }
+
+    //! @brief Copy the newest samples, newest first.
+    //! @return The number of samples copied, at most samples.size() and CAPACITY - 1.
+    std::size_t last(std::span<Sample> samples) const
+    {
+        return copy(samples, std::chrono::steady_clock::time_point::min());
+    }
+
+    //! @brief Copy the samples received since duration, newest first.
+    //! @return The number of samples copied, at most samples.size() and CAPACITY - 1.
+    template<typename _Rep, typename _Period>
+    std::size_t window(const std::chrono::duration<_Rep, _Period> & duration, std::span<Sample> samples) const
+    {
+        return copy(samples, std::chrono::steady_clock::now()
+                - std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+    }
+
+    //! @return The statistics of the count newest samples.
+    Statistics lastStatistics(std::size_t count) const
+    {
+        std::array<Sample, CAPACITY> samples;
+        return statistics(std::span<const Sample>(samples.data(), last(std::span<Sample>(samples.data(), std::min(count, CAPACITY)))));
+    }
+
+    //! @return The statistics of the samples received since duration.
+    template<typename _Rep, typename _Period>
+    Statistics windowStatistics(const std::chrono::duration<_Rep, _Period> & duration) const
+    {
+        std::array<Sample, CAPACITY> samples;
+        return statistics(std::span<const Sample>(samples.data(), window(duration, samples)));
+    }
+
+    //! @param samples Newest first, as returned by last or window.
+    static Statistics statistics(std::span<const Sample> samples)
+    {
+        Statistics result = {};
+        if (samples.empty())
+            return result;
+        double sum = 0.0;
+        result.min = samples.front().value;
+        result.max = samples.front().value;
+        for (const Sample & sample : samples)
+        {
+            sum += static_cast<double>(sample.value);
+            result.min = std::min(result.min, sample.value);
+            result.max = std::max(result.max, sample.value);
+        }
+        result.count = samples.size();
+        result.mean = sum/static_cast<double>(samples.size());
+        std::chrono::duration<double> duration = samples.front().receiveTime - samples.back().receiveTime;
+        if (duration.count() > 0.0)
+            result.rateOfChange = (static_cast<double>(samples.front().value) - static_cast<double>(samples.back().value))/duration.count();
+        return result;
+    }
+
+private:
+    SensorHistory(const SensorHistory &) = delete;
+    SensorHistory & operator=(const SensorHistory &) = delete;
+
+    std::size_t copy(std::span<Sample> samples, std::chrono::steady_clock::time_point since) const
+    {
+        std::uint64_t pushCount = _pushCount.load(std::memory_order_acquire);
+        std::uint64_t maxCount = std::min<std::uint64_t>({pushCount, CAPACITY, samples.size()});
+        std::size_t count = 0;
+        for (; count < maxCount; count++)
+        {
+            const Slot & slot = _slots[(pushCount - 1 - count)%CAPACITY];
+            Sample & sample = samples[count];
+            sample.value = slot._value.load(std::memory_order_relaxed);
+            sample.changedCount = slot._changedCount.load(std::memory_order_relaxed);
+            sample.receiveTime = std::chrono::steady_clock::time_point(
+                    std::chrono::steady_clock::duration(slot._receiveTime.load(std::memory_order_relaxed)));
+            if (sample.receiveTime < since)
+                break;
+        }
+
+        // Drop the samples which may have been overwritten during the copy: the writer can be writing
+        // the slot of the sample number pushCountEnd - CAPACITY
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t pushCountEnd = _pushCount.load(std::memory_order_relaxed);
+        if (pushCountEnd - pushCount >= CAPACITY)
+            return 0;
+        return std::min<std::size_t>(count, CAPACITY - 1 - (pushCountEnd - pushCount));
+    }
+
+    struct Slot
+    {
+        Slot() : _value(T()), _changedCount(0), _receiveTime(0) {}
+        std::atomic<T> _value;
+        std::atomic<int> _changedCount;
+        std::atomic<std::chrono::steady_clock::rep> _receiveTime;
+    };
+    std::array<Slot, CAPACITY> _slots;
+    std::atomic<std::uint64_t> _pushCount;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef SENSORSUBSCRIPTION_HPP
+#define SENSORSUBSCRIPTION_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+
+//! @brief Every update of a set of sensor events and indexes, queued in order for one consumer.
+//! The thread receiving the notifications pushes each accepted update into a fixed capacity single
+//! producer single consumer ring, without lock or allocation while the consumer keeps up. The consumer
+//! either polls batches of updates, or lets a dispatcher thread call a callback with them.
+//! No update is dropped: when the ring is full the producer waits for the consumer, so a slow
+//! consumer slows down the reception instead of losing updates.
+//! @param EVENT_TYPE_COUNT Number of values of EventType, which must start from 0 and be contiguous.
+template<typename EventType, std::size_t EVENT_TYPE_COUNT>
+class SensorSubscription
+{
+public:
+    struct Update
+    {
+        EventType eventType;
+        std::size_t index;
+        std::int64_t value; //!< Boolean values are 0 or 1
+        int changedCount;
+        std::chrono::steady_clock::time_point receiveTime;
+    };
+
+    //! @brief Events and indexes to subscribe to.
+    class Filter
+    {
+    public:
+        Filter() : _indexMasks() {}
+
+        //! @brief Accept these indexes of this event, or all its indexes if indexes is empty.
+        Filter & add(EventType eventType, std::initializer_list<std::size_t> indexes = {})
+        {
+            std::uint64_t & indexMask = _indexMasks[static_cast<std::size_t>(eventType)];
+            if (indexes.size() == 0)
+                indexMask = ALL_INDEXES;
+            for (std::size_t index : indexes)
+                indexMask |= index < 64 ? std::uint64_t(1) << index : 0;
+            return *this;
+        }
+
+        inline bool accepts(EventType eventType, std::size_t index) const
+        {
+            std::uint64_t indexMask = _indexMasks[static_cast<std::size_t>(eventType)];
+            return indexMask == ALL_INDEXES || (index < 64 && (indexMask & (std::uint64_t(1) << index)) != 0);
+        }
+
+    private:
+        static constexpr std::uint64_t ALL_INDEXES = ~std::uint64_t(0);
+        std::array<std::uint64_t, EVENT_TYPE_COUNT> _indexMasks;
+    };
+
+    struct Config
+    {
+        std::size_t capacity = 4096; //!< Updates queued before the producer waits, rounded up to a power of 2
+        std::size_t maxBatchSize = 256; //!< Maximum number of updates given to one dispatcher callback
+    };
+
+    //! @brief Called from the dispatcher thread with the updates in their receive order.
+    using Callback = std::function<void(std::span<const Update> updates)>;
+
+    SensorSubscription(const Filter & filter, const Config & config)
+        : _filter(filter)
+        , _config(config)
+        , _buffer(roundUpToPowerOf2(config.capacity))
+        , _mask(_buffer.size() - 1)
+        , _head(0)
+        , _tail(0)
+        , _mutex()
+        , _consumerCv()
+        , _producerCv()
+        , _isConsumerWaiting(false)
+        , _isProducerWaiting(false)
+        , _isClosed(false)
+        , _pushCount(0)
+        , _producerWaitCount(0)
+        , _dispatcherThread()
+    {}
+
+    //! @brief Close and wait the dispatcher thread if started.
+    ~SensorSubscription()
+    {
+        close();
+        if (_dispatcherThread.joinable() && _dispatcherThread.get_id() != std::this_thread::get_id())
+            _dispatcherThread.join();
+        else if (_dispatcherThread.joinable())
+            _dispatcherThread.detach();
+    }
+
+    const Filter & filter() const {return _filter;}
+
+    //! @brief Start a thread calling callback with each batch of updates, as soon as they are received.
+    //! All the updates already queued are delivered before the thread ends on close.
+    void startDispatch(const Callback & callback)
+    {
+        _dispatcherThread = std::thread([this, callback]{
+            std::vector<Update> updates(std::max<std::size_t>(_config.maxBatchSize, 1));
+            while (true)
+            {
+                std::size_t updateCount = wait(std::span<Update>(updates));
+                if (updateCount == 0)
+                    return;
+                callback(std::span<const Update>(updates.data(), updateCount));
+            }
+        });
+    }
+
+    //! @brief Queue an update, only from the thread receiving the notifications.
+    //! Wait while the ring is full, unless the subscription is closed (the update is then dropped).
+    void push(const Update & update)
+    {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) > _mask)
+        {
+            std::unique_lock<std::mutex> lk(_mutex);
+            _producerWaitCount.fetch_add(1, std::memory_order_relaxed);
+            _isProducerWaiting.store(true);
+            _producerCv.wait(lk, [this, tail]{return tail - _head.load() <= _mask || _isClosed;});
+            _isProducerWaiting.store(false);
+            if (_isClosed)
+                return;
+        }
+        _buffer[tail & _mask] = update;
+        _tail.store(tail + 1);
+        _pushCount.fetch_add(1, std::memory_order_relaxed);
+        if (_isConsumerWaiting.load())
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            _consumerCv.notify_one();
+        }
+    }
+
+    //! @brief Copy the queued updates without waiting, only from one consumer thread.
+    //! @return The number of updates copied, at most updates.size().
+    std::size_t poll(std::span<Update> updates)
+    {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t updateCount = std::min(_tail.load(std::memory_order_acquire) - head, updates.size());
+        for (std::size_t i = 0; i < updateCount; i++)
+            updates[i] = _buffer[(head + i) & _mask];
+        _head.store(head + updateCount);
+        if (updateCount > 0 && _isProducerWaiting.load())
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            _producerCv.notify_one();
+        }
+        return updateCount;
+    }
+
+    //! @brief Wait until at least one update is queued, then copy the queued updates.
+    //! @return The number of updates copied, 0 only if the subscription is closed and empty.
+    std::size_t wait(std::span<Update> updates)
+    {
+        std::size_t updateCount = poll(updates);
+        if (updateCount > 0 || updates.empty())
+            return updateCount;
+        {
+            std::unique_lock<std::mutex> lk(_mutex);
+            _isConsumerWaiting.store(true);
+            _consumerCv.wait(lk, [this]{return _tail.load() != _head.load(std::memory_order_relaxed) || _isClosed;});
+            _isConsumerWaiting.store(false);
+        }
+        return poll(updates);
+    }
+
+    //! @brief Stop queueing updates and wake up the waiting consumer and producer.
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            _isClosed = true;
+        }
+        _consumerCv.notify_all();
+        _producerCv.notify_all();
+    }
+
+    bool isClosed() const {return _isClosed;}
+
+    //! @name Statistics, can be read from any thread
+    //! \{
+    std::uint64_t pushCount() const {return _pushCount.load(std::memory_order_relaxed);}
+    //! @return Number of times the producer had to wait for a full ring.
+    std::uint64_t producerWaitCount() const {return _producerWaitCount.load(std::memory_order_relaxed);}
+    //! \}
+
+private:
+    SensorSubscription(const SensorSubscription &) = delete;
+    SensorSubscription & operator=(const SensorSubscription &) = delete;
+
+    static std::size_t roundUpToPowerOf2(std::size_t value)
+    {
+        std::size_t powerOf2 = 2;
+        while (powerOf2 < value)
+            powerOf2 *= 2;
+        return powerOf2;
+    }
+
+    const Filter _filter;
+    const Config _config;
+    std::vector<Update> _buffer;
+    const std::size_t _mask;
+    // Sequentially consistent stores and loads of the indexes and waiting flags, so a producer and a
+    // consumer going to sleep at the same time always see each other
+    std::atomic<std::size_t> _head; //!< Next update to read, only written by the consumer
+    std::atomic<std::size_t> _tail; //!< Next update to write, only written by the producer
+    std::mutex _mutex; //!< Only taken to sleep or to wake up
+    std::condition_variable _consumerCv;
+    std::condition_variable _producerCv;
+    std::atomic<bool> _isConsumerWaiting;
+    std::atomic<bool> _isProducerWaiting;
+    std::atomic<bool> _isClosed;
+    std::atomic<std::uint64_t> _pushCount;
+    std::atomic<std::uint64_t> _producerWaitCount;
+    std::thread _dispatcherThread;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <atomic>
+
+
+//! @brief Sequence lock: readers never block the writer and retry if a write happens during their read.
+//! Protected data must be read and written with relaxed atomics.
+//! @warning Only one thread at a time can write.
+class SeqLock
+{
+public:
+    SeqLock() : _sequence(0) {}
+
+    inline void writeBegin()
+    {
+        _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    inline void writeEnd()
+    {
+        _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    //! @brief Call function until it has been executed without any concurrent write.
+    template<typename Function>
+    void read(Function function) const
+    {
+        unsigned sequenceBegin, sequenceEnd;
+        do
+        {
+            sequenceBegin = _sequence.load(std::memory_order_acquire);
+            function();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            sequenceEnd = _sequence.load(std::memory_order_relaxed);
+        } while ((sequenceBegin & 1) != 0 || sequenceBegin != sequenceEnd);
+    }
+
+private:
+    SeqLock(const SeqLock &) = delete;
+    SeqLock & operator=(const SeqLock &) = delete;
+
+    std::atomic<unsigned> _sequence;
+};
+
+#endif
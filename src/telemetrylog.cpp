@@ -0,0 +1,99 @@
+#include "telemetrylog.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fstream>
+#include <iterator>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+TelemetryRecorder::TelemetryRecorder(const std::string & path)
+    : _file(std::fopen(path.c_str(), "wb"))
+{
+    if (_file == nullptr)
+        throw std::runtime_error(std::string("Cannot create telemetry log ") + path + ": " + std::strerror(errno));
+    TelemetryLogHeader header;
+    std::memcpy(header.magic, TelemetryLogHeader::MAGIC, sizeof(header.magic));
+    header.version = TelemetryLogHeader::VERSION;
+    header.recordSize = sizeof(TelemetryRecord);
+    header.reserved = 0;
+    std::fwrite(&header, sizeof(header), 1, _file);
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+    std::fclose(_file);
+}
+
+void TelemetryRecorder::record(const TelemetryRecord & record)
+{
+    if (std::fwrite(&record, sizeof(record), 1, _file) != 1)
+        throw std::runtime_error(std::string("Cannot write telemetry log: ") + std::strerror(errno));
+}
+
+void TelemetryRecorder::flush()
+{
+    std::fflush(_file);
+}
+
+TelemetryLog::TelemetryLog(const std::string & path)
+    : _mapping()
+    , _dataSize(0)
+    , _fallbackData()
+    , _records(nullptr)
+    , _recordCount(0)
+{
+    const char * data = nullptr;
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("Cannot open telemetry log ") + path + ": " + std::strerror(errno));
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        _dataSize = static_cast<std::size_t>(fileStat.st_size);
+        void * mappedData = ::mmap(nullptr, _dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mappedData != MAP_FAILED)
+        {
+            _mapping.data = mappedData;
+            _mapping.size = _dataSize;
+        }
+    }
+    ::close(fd);
+    if (_mapping.data == nullptr)
+        throw std::runtime_error(std::string("Cannot map telemetry log ") + path);
+    data = static_cast<const char *>(_mapping.data);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(std::string("Cannot open telemetry log ") + path);
+    _fallbackData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    _dataSize = _fallbackData.size();
+    data = _fallbackData.data();
+#endif
+
+    TelemetryLogHeader header;
+    if (_dataSize < sizeof(header))
+        throw std::runtime_error(std::string("Truncated telemetry log ") + path);
+    std::memcpy(&header, data, sizeof(header));
+    if (   std::memcmp(header.magic, TelemetryLogHeader::MAGIC, sizeof(header.magic)) != 0
+        || header.version != TelemetryLogHeader::VERSION
+        || header.recordSize != sizeof(TelemetryRecord))
+        throw std::runtime_error(std::string("Unsupported telemetry log ") + path);
+    _records = reinterpret_cast<const TelemetryRecord *>(data + sizeof(header));
+    _recordCount = (_dataSize - sizeof(header))/sizeof(TelemetryRecord);
+}
+
+TelemetryLog::Mapping::~Mapping()
+{
+#ifndef _WIN32
+    if (data != nullptr)
+        ::munmap(data, size);
+#endif
+}
@@ -0,0 +1,99 @@
+#ifndef TELEMETRYLOG_HPP
+#define TELEMETRYLOG_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+//! @brief One fixed size record of a telemetry log.
+//! A log is a TelemetryLogHeader followed by records, in native endianness, so it can be memory mapped.
+struct TelemetryRecord
+{
+    enum class Type : std::uint8_t
+    {
+        NOTIFICATION, //!< A sensor value received from the robot server
+        MOTORS_COMMAND //!< A motors power sent to the robot server
+    };
+    static constexpr std::uint8_t RIGHT_MOTOR = 1; //!< Bit of motorsMask set if rightValue is used
+    static constexpr std::uint8_t LEFT_MOTOR = 2; //!< Bit of motorsMask set if leftValue is used
+
+    std::int64_t timestamp; //!< Monotonic clock in nanosecond
+    std::int64_t value; //!< NOTIFICATION only
+    std::uint32_t index; //!< NOTIFICATION only
+    std::int32_t changedCount; //!< NOTIFICATION only
+    float rightValue; //!< MOTORS_COMMAND only
+    float leftValue; //!< MOTORS_COMMAND only
+    Type type;
+    std::uint8_t eventType; //!< NOTIFICATION only, the EventType value
+    std::uint8_t motorsMask; //!< MOTORS_COMMAND only
+    std::uint8_t reserved[5];
+};
+static_assert(sizeof(TelemetryRecord) == 40);
+
+struct TelemetryLogHeader
+{
+    static constexpr char MAGIC[4] = {'R', 'B', 'T', 'L'};
+    static constexpr std::uint32_t VERSION = 1;
+
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint32_t reserved;
+};
+static_assert(sizeof(TelemetryLogHeader) == 16);
+
+//! @brief Append telemetry records into a log file.
+//! @warning Not thread safe.
+class TelemetryRecorder
+{
+public:
+    //! @brief Create or truncate the log file.
+    TelemetryRecorder(const std::string & path);
+    ~TelemetryRecorder();
+
+    void record(const TelemetryRecord & record);
+    void flush();
+
+private:
+    TelemetryRecorder(const TelemetryRecorder &) = delete;
+    TelemetryRecorder & operator=(const TelemetryRecorder &) = delete;
+
+    std::FILE * _file;
+};
+
+//! @brief Read only, memory mapped, telemetry log file.
+class TelemetryLog
+{
+public:
+    TelemetryLog(const std::string & path);
+
+    const TelemetryRecord * begin() const {return _records;}
+    const TelemetryRecord * end() const {return _records + _recordCount;}
+    std::size_t size() const {return _recordCount;}
+
+private:
+    TelemetryLog(const TelemetryLog &) = delete;
+    TelemetryLog & operator=(const TelemetryLog &) = delete;
+
+    //! @brief Memory map of the file, unmapped by its destructor, also when the constructor throws.
+    struct Mapping
+    {
+        Mapping() : data(nullptr), size(0) {}
+        ~Mapping();
+        Mapping(const Mapping &) = delete;
+        Mapping & operator=(const Mapping &) = delete;
+
+        void * data;
+        std::size_t size;
+    };
+
+    Mapping _mapping;
+    std::size_t _dataSize;
+    std::vector<char> _fallbackData; //!< Content of the file where memory map is not available
+    const TelemetryRecord * _records;
+    std::size_t _recordCount;
+};
+
+#endif
@@ -1,7 +1,16 @@
 #ifndef VALUES_HPP
 #define VALUES_HPP
 
-#include <optional>
+#include "seqlock.hpp"
+#include "sensorhistory.hpp"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
 
 
 template<typename EventType>
@@ -13,41 +22,136 @@ public:
 };
 
 
-template<typename T, typename EventType, EventType EVENT_TYPE_VALUE>
+//! @brief Last values received for one sensor family, with a fixed number of sensor index.
+//! The HISTORY_CAPACITY last samples of each index are also kept with their receive time.
+//! Getters are lock-free and never block the thread calling set.
+//! @warning Only one thread at a time can call set.
+template<typename T, typename EventType, EventType EVENT_TYPE_VALUE, std::size_t CAPACITY = 16, std::size_t HISTORY_CAPACITY = 64>
 class Values
 {
 public:
-    Values(IRobot<EventType> * robot) : _robot(robot) {}
+    using History = SensorHistory<T, HISTORY_CAPACITY>;
+    static constexpr std::size_t INDEX_CAPACITY = CAPACITY; //!< Sensor indexes are below
+
+    //! @brief Consistent copy of all the values of this sensor family.
+    struct Snapshot
+    {
+        std::size_t size; //!< Number of sensor index received
+        std::array<T, CAPACITY> values;
+        std::array<int, CAPACITY> changedCounts;
+
+        inline T get(std::size_t index) const {if (index>=size) return {}; return values[index];}
+        inline int getChangedCount(std::size_t index) const {if (index>=size) return 0; return changedCounts[index];}
+    };
+
+    //! @param seqLock Lock shared between all the values to be able to make a consistent snapshot of them.
+    Values(IRobot<EventType> * robot, SeqLock & seqLock) : _size(0), _values(), _histories(), _seqLock(seqLock), _robot(robot) {}
+
+    inline T get(std::size_t index) const {if (index>=CAPACITY) return {}; return _values[index]._value.load(std::memory_order_relaxed);}
+    inline int getChangedCount(std::size_t index) const {if (index>=CAPACITY) return 0; return _values[index]._changedCount.load(std::memory_order_relaxed);}
+
+    //! @return The number of updates of this index skipped by the changed counts received.
+    inline std::uint64_t getMissedCount(std::size_t index) const {if (index>=CAPACITY) return 0; return _values[index]._missedCount.load(std::memory_order_relaxed);}
+    //! @return The number of updates of this index received after a newer one, and so dropped.
+    inline std::uint64_t getStaleCount(std::size_t index) const {if (index>=CAPACITY) return 0; return _values[index]._staleCount.load(std::memory_order_relaxed);}
+
+    //! @return The last samples of this index, with an empty history if index is out of capacity.
+    inline const History & history(std::size_t index) const {static const History empty; if (index>=CAPACITY) return empty; return _histories[index];}
+
+    //! @brief Keep the changed counts increasing on a new connexion, from the thread calling set.
+    //! The first update of each index after it continues from the current changed count if the robot
+    //! server has restarted its own counts, instead of being dropped as stale.
+    void resume()
+    {
+        for (Value & value : _values)
+            value._isResumed = true;
+    }
 
-    inline T get(std::size_t index) const {const std::lock_guard<std::mutex> lock(_mutex); if (index>=_values.size()) return {}; return _values.at(index)._value.value();}
-    inline int getChangedCount(std::size_t index) const {const std::lock_guard<std::mutex> lock(_mutex); if (index>=_values.size()) return 0; return _values.at(index)._changedCount.value();}
-    void set(std::size_t index, T v, int changedCount)
+    //! @brief Store a new value of this index, unless it is older than the current one.
+    //! Each index is expected to increment its changed count by one at each update.
+    //! @return The number of updates missed before this one, or -1 if this one is stale and has been dropped.
+    int set(std::size_t index, T v, int changedCount,
+            std::chrono::steady_clock::time_point receiveTime = std::chrono::steady_clock::now())
     {
-        const std::lock_guard<std::mutex> lock(_mutex);
-        if (index>=_values.size())
-            _values.resize(index+1);
-        Value & value = _values.at(index);
-        value._value = v;
-        if (value._changedCount.has_value())
+        if (index>=CAPACITY)
+            throw std::out_of_range(std::string("Sensor index ") + std::to_string(index)
+                    + " out of capacity " + std::to_string(CAPACITY));
+        Value & value = _values[index];
+        int missedCount = 0;
+        changedCount += value._changedCountOffset;
+        if (value._isSet)
         {
-            value._changedCount.value()++;
-            assert(value._changedCount == changedCount);
+            int lastChangedCount = value._changedCount.load(std::memory_order_relaxed);
+            if (value._isResumed && changedCount <= lastChangedCount)
+            {
+                value._changedCountOffset += lastChangedCount + 1 - changedCount;
+                changedCount = lastChangedCount + 1;
+            }
+            if (changedCount <= lastChangedCount)
+            {
+                value._staleCount.fetch_add(1, std::memory_order_relaxed);
+                return -1;
+            }
+            missedCount = changedCount - lastChangedCount - 1;
+            if (missedCount > 0)
+                value._missedCount.fetch_add(missedCount, std::memory_order_relaxed);
         }
-        else
-            value._changedCount = changedCount;
+        value._isSet = true;
+        value._isResumed = false;
+
+        _seqLock.writeBegin();
+        value._value.store(v, std::memory_order_relaxed);
+        value._changedCount.store(changedCount, std::memory_order_relaxed);
+        if (index>=_size.load(std::memory_order_relaxed))
+            _size.store(index+1, std::memory_order_relaxed);
+        _seqLock.writeEnd();
+        _histories[index].push(v, changedCount, receiveTime);
+
         _robot->notify(EVENT_TYPE_VALUE, changedCount);
+        return missedCount;
+    }
+
+    //! @return A consistent copy of all the values.
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot;
+        _seqLock.read([this, &snapshot]{load(snapshot);});
+        return snapshot;
+    }
+
+    //! @brief Copy all the values without any consistency check.
+    //! @warning Must be called from SeqLock::read of the seqLock given in constructor.
+    void load(Snapshot & snapshot) const
+    {
+        snapshot.size = _size.load(std::memory_order_relaxed);
+        for (std::size_t index = 0; index < CAPACITY; index++)
+        {
+            snapshot.values[index] = _values[index]._value.load(std::memory_order_relaxed);
+            snapshot.changedCounts[index] = _values[index]._changedCount.load(std::memory_order_relaxed);
+        }
     }
 
 private:
+    Values(const Values &) = delete;
+    Values & operator=(const Values &) = delete;
+
     struct Value
     {
-        Value() : _value(), _changedCount() {}
-        std::optional<T> _value;
-        std::optional<int> _changedCount;
+        Value() : _value(T()), _changedCount(0), _missedCount(0), _staleCount(0), _isSet(false), _isResumed(false)
+                , _changedCountOffset(0) {}
+        std::atomic<T> _value;
+        std::atomic<int> _changedCount;
+        std::atomic<std::uint64_t> _missedCount;
+        std::atomic<std::uint64_t> _staleCount;
+        bool _isSet; //!< Only used by the thread calling set
+        bool _isResumed; //!< Only used by the thread calling set
+        int _changedCountOffset; //!< Added to the received changed counts, only used by the thread calling set
     };
-    std::vector<Value> _values;
-    mutable std::mutex _mutex;
+    std::atomic<std::size_t> _size;
+    std::array<Value, CAPACITY> _values;
+    std::array<History, CAPACITY> _histories;
+    SeqLock & _seqLock;
     IRobot<EventType> * _robot;
 };
 
-#endif 
+#endif
@@ -0,0 +1,159 @@
+#include "wheelspeedcontroller.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+
+WheelSpeedController::WheelSpeedController(const Config & config, const Output & output)
+    : _mutex()
+    , _config()
+    , _output(output)
+    , _isEnabled(false)
+    , _wheelStates()
+{
+    setConfig(config);
+}
+
+void WheelSpeedController::setConfig(const Config & config)
+{
+    if (config.maxPower <= 0.0 || config.powerDeadband < 0.0)
+        throw std::invalid_argument(std::string("Invalid wheel speed controller config: max power ") + std::to_string(config.maxPower)
+                + " must be positive and power deadband " + std::to_string(config.powerDeadband) + " not negative");
+    std::lock_guard<std::mutex> lk(_mutex);
+    _config = config;
+}
+
+void WheelSpeedController::setTargetSpeeds(double rightSpeed, double leftSpeed)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    if (!_isEnabled)
+    {
+        // Start from the feed forward only, and give the first power whatever the last one
+        for (WheelState & state : _wheelStates)
+        {
+            state.integral = 0.0;
+            state.lastPower.reset();
+        }
+    }
+    _wheelStates[static_cast<std::size_t>(Wheel::RIGHT)].targetSpeed = rightSpeed;
+    _wheelStates[static_cast<std::size_t>(Wheel::LEFT)].targetSpeed = leftSpeed;
+    _isEnabled = true;
+}
+
+void WheelSpeedController::disable()
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    _isEnabled = false;
+}
+
+bool WheelSpeedController::isEnabled() const
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    return _isEnabled;
+}
+
+void WheelSpeedController::reset()
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    for (WheelState & state : _wheelStates)
+    {
+        state.windowBeginDistance.reset();
+        state.lastSpeed.reset();
+        state.integral = 0.0;
+        state.lastPower.reset();
+    }
+}
+
+void WheelSpeedController::update(Wheel wheel, double distance, std::chrono::steady_clock::time_point time)
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    WheelState & state = _wheelStates[static_cast<std::size_t>(wheel)];
+    if (!state.windowBeginDistance.has_value())
+    {
+        state.windowBeginDistance = distance;
+        state.windowBeginTime = time;
+        return;
+    }
+
+    std::chrono::duration<double> duration = time - state.windowBeginTime;
+    if (duration < _config.speedWindow || duration.count() <= 0.0)
+        return;
+    double speed = (distance - state.windowBeginDistance.value())/duration.count();
+    state.windowBeginDistance = distance;
+    state.windowBeginTime = time;
+    state.lastMeasuredSpeed = speed;
+
+    std::optional<float> power;
+    if (_isEnabled)
+        power = step(state, speed, duration.count());
+    state.lastSpeed = speed;
+    // With the lock held, so a manual command following disable is never overwritten by this power
+    if (power.has_value())
+        _output(wheel, power.value());
+}
+
+WheelSpeedController::TrackingStatistics WheelSpeedController::trackingStatistics(Wheel wheel) const
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    const WheelState & state = _wheelStates[static_cast<std::size_t>(wheel)];
+    TrackingStatistics statistics = {};
+    statistics.stepCount = state.stepCount;
+    if (state.stepCount > 0)
+    {
+        statistics.meanAbsoluteError = state.absoluteErrorSum/static_cast<double>(state.stepCount);
+        statistics.rmsError = std::sqrt(state.squaredErrorSum/static_cast<double>(state.stepCount));
+    }
+    statistics.maxAbsoluteError = state.maxAbsoluteError;
+    statistics.lastSpeed = state.lastMeasuredSpeed;
+    statistics.lastPower = state.lastPower.value_or(0.0f);
+    return statistics;
+}
+
+void WheelSpeedController::resetTrackingStatistics()
+{
+    std::lock_guard<std::mutex> lk(_mutex);
+    for (WheelState & state : _wheelStates)
+    {
+        state.stepCount = 0;
+        state.absoluteErrorSum = 0.0;
+        state.squaredErrorSum = 0.0;
+        state.maxAbsoluteError = 0.0;
+    }
+}
+
+std::optional<float> WheelSpeedController::step(WheelState & state, double speed, double duration)
+{
+    double error = state.targetSpeed - speed;
+    state.stepCount++;
+    state.absoluteErrorSum += std::abs(error);
+    state.squaredErrorSum += error*error;
+    state.maxAbsoluteError = std::max(state.maxAbsoluteError, std::abs(error));
+
+    double power = 0.0;
+    if (state.targetSpeed == 0.0)
+        // Stop without hunting around zero
+        state.integral = 0.0;
+    else
+    {
+        // Derivative on the measure, so a target change gives no kick
+        double derivative = state.lastSpeed.has_value() ? -(speed - state.lastSpeed.value())/duration : 0.0;
+        double basePower = _config.feedForward*state.targetSpeed + _config.kp*error + _config.kd*derivative;
+        double integral = state.integral + error*duration;
+        power = basePower + _config.ki*integral;
+        // Only integrate while not saturated, or while the error brings the power back into range
+        if ((power > _config.maxPower && error > 0.0) || (power < -_config.maxPower && error < 0.0))
+            power = basePower + _config.ki*state.integral;
+        else
+            state.integral = integral;
+        power = std::clamp(power, -_config.maxPower, _config.maxPower);
+    }
+
+    float newPower = static_cast<float>(power);
+    if (state.lastPower.has_value() && std::abs(newPower - state.lastPower.value()) < _config.powerDeadband
+            && (newPower != 0.0f || state.lastPower.value() == 0.0f))
+        return std::nullopt;
+    state.lastPower = newPower;
+    return newPower;
+}
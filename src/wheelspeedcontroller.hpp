@@ -0,0 +1,109 @@
+#ifndef WHEELSPEEDCONTROLLER_HPP
+#define WHEELSPEEDCONTROLLER_HPP
+
+#include "odometry.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+
+//! @brief Closed loop speed of the two wheels of a differential drive robot, one PID per wheel.
+//! Each wheel speed is measured from the distance it has traveled, and a new motor power is computed
+//! at each measure, from the feed forward of the target speed corrected by the PID. The integral term
+//! stops growing while the power is saturated (anti-windup), and a new power is only given when it
+//! differs enough from the last one given. The powers are given with the lock of the controller held,
+//! so none is given once disable has returned.
+class WheelSpeedController
+{
+public:
+    using Wheel = Odometry::Wheel;
+
+    //! Defaults for the simu robot, whose wheel speed is 200 pixels per second at power 1.0
+    struct Config
+    {
+        double feedForward = 1.0/200.0; //!< Power per unit per second of target speed
+        double kp = 0.002; //!< Power per unit per second of speed error
+        double ki = 0.01; //!< Power per unit of integrated speed error
+        double kd = 0.0; //!< Power per unit per second squared of speed change, on the measure only
+        double maxPower = 1.0; //!< The power is clamped to [-maxPower, maxPower]
+        double powerDeadband = 0.01; //!< Minimum power change to give a new power
+        //! Minimum duration over which a wheel speed is measured, to smooth the encoder resolution
+        std::chrono::nanoseconds speedWindow = std::chrono::milliseconds(20);
+    };
+
+    //! @brief Speed error of one wheel, measured at each control step since the last reset.
+    struct TrackingStatistics
+    {
+        std::uint64_t stepCount;
+        double meanAbsoluteError; //!< In unit per second
+        double rmsError; //!< In unit per second
+        double maxAbsoluteError; //!< In unit per second
+        double lastSpeed; //!< Last speed measured, in unit per second
+        double lastPower; //!< Last power given
+    };
+
+    //! @brief Called by update with the new power of a wheel.
+    using Output = std::function<void(Wheel wheel, float power)>;
+
+    WheelSpeedController(const Config & config, const Output & output);
+
+    //! @brief Change the config, the integral terms are kept.
+    void setConfig(const Config & config);
+
+    //! @brief Start the control of both wheels to these speeds, in unit per second (positive forward).
+    void setTargetSpeeds(double rightSpeed, double leftSpeed);
+
+    //! @brief Stop the control, output is not called anymore until the next setTargetSpeeds.
+    //! Wait for the end of the output call in progress if any.
+    void disable();
+
+    bool isEnabled() const;
+
+    //! @brief Forget the speed measures and the integral terms, when the distances may have jumped.
+    //! The targets are kept.
+    void reset();
+
+    //! @brief Take the new distance traveled by one wheel and run a control step if its speed window
+    //! is complete. Output is called with the new power of this wheel, unless it has not changed enough
+    //! or the control is disabled.
+    //! @param distance Signed distance traveled by the wheel since any fixed origin, in unit.
+    void update(Wheel wheel, double distance, std::chrono::steady_clock::time_point time);
+
+    //! @return The speed error statistics of this wheel.
+    TrackingStatistics trackingStatistics(Wheel wheel) const;
+    void resetTrackingStatistics();
+
+private:
+    WheelSpeedController(const WheelSpeedController &) = delete;
+    WheelSpeedController & operator=(const WheelSpeedController &) = delete;
+
+    struct WheelState
+    {
+        double targetSpeed = 0.0;
+        std::optional<double> windowBeginDistance; //!< None until the first distance
+        std::chrono::steady_clock::time_point windowBeginTime;
+        std::optional<double> lastSpeed; //!< None until the first measure, for the derivative term
+        double integral = 0.0;
+        std::optional<float> lastPower; //!< Last power given, none if not given since the enable
+        // Tracking statistics
+        std::uint64_t stepCount = 0;
+        double absoluteErrorSum = 0.0;
+        double squaredErrorSum = 0.0;
+        double maxAbsoluteError = 0.0;
+        double lastMeasuredSpeed = 0.0;
+    };
+
+    std::optional<float> step(WheelState & state, double speed, double duration);
+
+    mutable std::mutex _mutex; //!< Serialize the update from the receive thread and the changes from the others
+    Config _config;
+    Output _output;
+    bool _isEnabled;
+    std::array<WheelState, 2> _wheelStates;
+};
+
+#endif
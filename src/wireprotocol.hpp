@@ -0,0 +1,118 @@
+#ifndef WIREPROTOCOL_HPP
+#define WIREPROTOCOL_HPP
+
+#include "indexedvaluenotification.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+//! @brief Encoding of the messages sent by the robot server.
+//! The connexion always starts in JSON: newline-delimited JSON-RPC messages. The client can then ask
+//! for the binary encoding with the JSON-RPC method WIRE_ENCODING_METHOD and params {"encoding":"binary"}.
+//! A server supporting it answers the result "binary" and sends all its next messages as binary
+//! frames, any other answer keeps JSON. The client always sends JSON.
+enum class WireEncoding {JSON, BINARY};
+
+constexpr const char * WIRE_ENCODING_METHOD = "setWireEncoding";
+
+//! @brief Binary frame: a little endian header {uint32 payload size, uint8 WireFrameType} then the payload.
+enum class WireFrameType : std::uint8_t
+{
+    JSON, //!< Payload is a JSON-RPC message without its end of line
+    INDEXED_VALUE //!< Payload is a sensor notification {uint8 IndexedValueMethod, uint16 index, int32 changedCount, int64 value}
+};
+constexpr std::size_t WIRE_FRAME_HEADER_SIZE = 5;
+constexpr std::size_t WIRE_INDEXED_VALUE_PAYLOAD_SIZE = 15;
+//! Larger payload sizes come from a corrupt header, rejected before buffering the payload
+constexpr std::size_t WIRE_MAX_PAYLOAD_SIZE = 1 << 20;
+
+namespace wireprotocol_detail
+{
+    template<typename T>
+    void appendLittleEndian(std::string & buffer, T value)
+    {
+        auto bits = static_cast<std::make_unsigned_t<T>>(value);
+        for (std::size_t i = 0; i < sizeof(T); i++)
+            buffer += static_cast<char>((bits >> (8*i)) & 0xFF);
+    }
+
+    template<typename T>
+    T readLittleEndian(const char * data)
+    {
+        std::make_unsigned_t<T> bits = 0;
+        for (std::size_t i = 0; i < sizeof(T); i++)
+            bits |= static_cast<std::make_unsigned_t<T>>(static_cast<std::uint8_t>(data[i])) << (8*i);
+        return static_cast<T>(bits);
+    }
+}
+
+inline void appendWireJsonFrame(std::string & buffer, std::string_view json)
+{
+    wireprotocol_detail::appendLittleEndian(buffer, static_cast<std::uint32_t>(json.size()));
+    buffer += static_cast<char>(WireFrameType::JSON);
+    buffer.append(json);
+}
+
+inline void appendWireIndexedValueFrame(std::string & buffer, IndexedValueMethod method, std::uint16_t index,
+        std::int32_t changedCount, std::int64_t value)
+{
+    wireprotocol_detail::appendLittleEndian(buffer, static_cast<std::uint32_t>(WIRE_INDEXED_VALUE_PAYLOAD_SIZE));
+    buffer += static_cast<char>(WireFrameType::INDEXED_VALUE);
+    buffer += static_cast<char>(method);
+    wireprotocol_detail::appendLittleEndian(buffer, index);
+    wireprotocol_detail::appendLittleEndian(buffer, changedCount);
+    wireprotocol_detail::appendLittleEndian(buffer, value);
+}
+
+//! @brief Find the first frame of received data.
+//! @param missingSize Set to the minimum number of bytes still to receive if the frame is incomplete.
+//! @return The whole size of the first frame, or 0 if it is not complete yet.
+//! @throw std::runtime_error If the payload size is above WIRE_MAX_PAYLOAD_SIZE.
+inline std::size_t wireFrameSize(const char * data, std::size_t size, std::size_t & missingSize)
+{
+    if (size < WIRE_FRAME_HEADER_SIZE)
+    {
+        missingSize = WIRE_FRAME_HEADER_SIZE - size;
+        return 0;
+    }
+    std::size_t payloadSize = wireprotocol_detail::readLittleEndian<std::uint32_t>(data);
+    if (payloadSize > WIRE_MAX_PAYLOAD_SIZE)
+        throw std::runtime_error("Wire frame payload of " + std::to_string(payloadSize) + " bytes above the maximum of "
+                + std::to_string(WIRE_MAX_PAYLOAD_SIZE));
+    std::size_t frameSize = WIRE_FRAME_HEADER_SIZE + payloadSize;
+    if (size < frameSize)
+    {
+        missingSize = frameSize - size;
+        return 0;
+    }
+    missingSize = 0;
+    return frameSize;
+}
+
+inline WireFrameType wireFrameType(const char * frame)
+{
+    return static_cast<WireFrameType>(frame[4]);
+}
+
+//! @brief Decode the payload of an INDEXED_VALUE frame.
+//! @return False if the payload size or the method is invalid.
+inline bool decodeWireIndexedValue(const char * payload, std::size_t payloadSize, IndexedValueNotification & notification)
+{
+    if (payloadSize != WIRE_INDEXED_VALUE_PAYLOAD_SIZE)
+        return false;
+    std::uint8_t methodId = static_cast<std::uint8_t>(payload[0]);
+    if (methodId >= INDEXED_VALUE_METHOD_COUNT)
+        return false;
+    notification.method = static_cast<IndexedValueMethod>(methodId);
+    notification.index = wireprotocol_detail::readLittleEndian<std::uint16_t>(payload + 1);
+    notification.changedCount = wireprotocol_detail::readLittleEndian<std::int32_t>(payload + 3);
+    notification.value = wireprotocol_detail::readLittleEndian<std::int64_t>(payload + 7);
+    return true;
+}
+
+#endif